@@ -1,6 +1,10 @@
 #pragma once
 
 #include <rx.modern.h>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
 namespace Rx {
 using namespace Modern;
 
@@ -10,125 +14,3406 @@ inline void print_error(std::exception_ptr ep) {
     catch (const std::exception& ex) { printf("\nerror! %s\n", ex.what()); }
 }
 
+// the value emitted for an IAsyncAction, which has no result
+struct unit
+{
+};
+
+inline bool operator==(unit, unit) { return true; }
+inline bool operator!=(unit, unit) { return false; }
+
+namespace detail {
+
+inline std::exception_ptr make_canceled_error() {
+    return std::make_exception_ptr(Modern::Exception(HRESULT_FROM_WIN32(ERROR_CANCELLED)));
+}
+
+template<class Async>
+void cancel_async(Async const & aop) {
+    // this is called from unsubscribe - swallow exception from cancel
+    try {
+        if (aop.Status() == AsyncStatus::Started) {
+            aop.Cancel();
+        }
+    }
+    catch (...) {}
+}
+
+template<class Async>
+void close_async(Async const & aop) {
+    // Close releases the Completed handler and with it the subscriber it captured
+    try { aop.Close(); }
+    catch (...) {}
+}
+
+template<class Async>
+struct async_traits;
+
 template<class Result>
-auto from_async(const Windows::Foundation::IAsyncOperation<Result>& aop) -> Rx::observable<Result> {
-    return Rx::create<Result>(
-        [=](Rx::subscriber<Result>& out) {
-            aop.Completed([=](Windows::Foundation::IAsyncOperation<Result> const & completed, AsyncStatus const &) {
-                try { out.on_next(completed.GetResults()); }
-                catch (...) { out.on_error(std::current_exception()); }
-                out.on_completed();
-            });
-            // no cancellation :(
-        })
-        .as_dynamic()
-        .publish()
-        .ref_count();
+struct async_traits<Windows::Foundation::IAsyncOperation<Result>>
+{
+    typedef Result result_type;
+    typedef Windows::Foundation::IAsyncOperationCompletedHandler<Result> completed_handler_type;
+
+    static result_type get_results(Windows::Foundation::IAsyncOperation<Result> const & aop) {
+        return aop.GetResults();
+    }
+
+    static HRESULT try_get_results(Windows::Foundation::IAsyncOperation<Result> const & aop, result_type & result) noexcept {
+        return aop->abi_GetResults(abi(&result));
+    }
+};
+
+template<class Result, class Progress>
+struct async_traits<Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>>
+{
+    typedef Result result_type;
+    typedef Windows::Foundation::IAsyncOperationWithProgressCompletedHandler<Result, Progress> completed_handler_type;
+
+    static result_type get_results(Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const & aop) {
+        return aop.GetResults();
+    }
+
+    static HRESULT try_get_results(Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const & aop, result_type & result) noexcept {
+        return aop->abi_GetResults(abi(&result));
+    }
+};
+
+template<>
+struct async_traits<Windows::Foundation::IAsyncAction>
+{
+    typedef unit result_type;
+    typedef Windows::Foundation::IAsyncActionCompletedHandler completed_handler_type;
+
+    static result_type get_results(Windows::Foundation::IAsyncAction const & aop) {
+        aop.GetResults();
+        return unit();
+    }
+
+    static HRESULT try_get_results(Windows::Foundation::IAsyncAction const & aop, result_type &) noexcept {
+        return aop->abi_GetResults();
+    }
+};
+
+template<class Progress>
+struct async_traits<Windows::Foundation::IAsyncActionWithProgress<Progress>>
+{
+    typedef unit result_type;
+    typedef Windows::Foundation::IAsyncActionWithProgressCompletedHandler<Progress> completed_handler_type;
+
+    static result_type get_results(Windows::Foundation::IAsyncActionWithProgress<Progress> const & aop) {
+        aop.GetResults();
+        return unit();
+    }
+
+    static HRESULT try_get_results(Windows::Foundation::IAsyncActionWithProgress<Progress> const & aop, result_type &) noexcept {
+        return aop->abi_GetResults();
+    }
+};
+
+// the default - a failed operation is an on_error with the exception
+// thrown by GetResults
+template<class Async>
+struct throwing_results
+{
+    typedef typename async_traits<Async>::result_type result_type;
+
+    static void complete(Async const & aop, AsyncStatus status, Rx::maybe<result_type>& result, std::exception_ptr& error) {
+        if (status == AsyncStatus::Canceled) {
+            error = make_canceled_error();
+            return;
+        }
+        try { result.reset(async_traits<Async>::get_results(aop)); }
+        catch (...) { error = std::current_exception(); }
+    }
+};
+
+// a subject for a single result. subscribers that arrive after completion
+// get the stored result, everyone gets it exactly once. the waiting
+// subscribers and the done flag share one atomic word - a list head that
+// completion swaps for a tag - so completion never takes a lock.
+template<class T>
+class replay_one
+{
+    struct node
+    {
+        Rx::subscriber<T> out;
+        node* next;
+    };
+
+    static node* done_tag() {
+        return reinterpret_cast<node*>(std::uintptr_t(1));
+    }
+
+    replay_one(const replay_one&);
+
+    std::atomic<node*> state;
+    Rx::maybe<T> result;
+    std::exception_ptr error;
+
+    void deliver(const Rx::subscriber<T>& out) const {
+        if (error) {
+            out.on_error(error);
+            return;
+        }
+        out.on_next(result.get());
+        out.on_completed();
+    }
+
+public:
+    replay_one()
+        : state(nullptr)
+    {
+    }
+
+    ~replay_one()
+    {
+        auto head = state.load();
+        while (head && head != done_tag()) {
+            auto next = head->next;
+            delete head;
+            head = next;
+        }
+    }
+
+    bool is_done() const {
+        return state.load(std::memory_order_acquire) == done_tag();
+    }
+
+    void add(Rx::subscriber<T> out) {
+        auto head = state.load(std::memory_order_acquire);
+        if (head != done_tag()) {
+            auto n = new node{out, head};
+            while (head != done_tag()) {
+                n->next = head;
+                if (state.compare_exchange_weak(head, n, std::memory_order_release, std::memory_order_acquire)) {
+                    return;
+                }
+            }
+            delete n;
+        }
+        deliver(out);
+    }
+
+    // frees the nodes of subscribers that have unsubscribed. the waiting list
+    // is taken whole, pruned and put back behind any nodes added meanwhile.
+    // if completion happened meanwhile it found the list empty, so whoever is
+    // left is delivered to here.
+    void sweep() {
+        auto head = state.load(std::memory_order_acquire);
+        while (head != done_tag() && !state.compare_exchange_weak(head, nullptr, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        }
+        if (head == done_tag()) {
+            return;
+        }
+
+        node* kept = nullptr;
+        node** tail = &kept;
+        while (head) {
+            auto next = head->next;
+            if (head->out.is_subscribed()) {
+                *tail = head;
+                tail = &head->next;
+            }
+            else {
+                delete head;
+            }
+            head = next;
+        }
+        *tail = nullptr;
+
+        while (kept) {
+            node* newer = nullptr;
+            if (state.compare_exchange_strong(newer, kept, std::memory_order_release, std::memory_order_acquire)) {
+                return;
+            }
+            if (newer == done_tag()) {
+                deliver_all(kept);
+                return;
+            }
+            if (state.compare_exchange_strong(newer, nullptr, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                auto last = newer;
+                while (last->next) {
+                    last = last->next;
+                }
+                last->next = kept;
+                kept = newer;
+            }
+        }
+    }
+
+    // must be called once
+    void complete(Rx::maybe<T> value, std::exception_ptr e) {
+        result = std::move(value);
+        error = e;
+        deliver_all(state.exchange(done_tag(), std::memory_order_acq_rel));
+    }
+
+private:
+    void deliver_all(node* head) const {
+        // deliver in subscription order
+        node* ordered = nullptr;
+        while (head) {
+            auto next = head->next;
+            head->next = ordered;
+            ordered = head;
+            head = next;
+        }
+        while (ordered) {
+            auto next = ordered->next;
+            deliver(ordered->out);
+            delete ordered;
+            ordered = next;
+        }
+    }
+};
+
+// the Completed handler registered with the operation is also the multicast
+// state shared by all the subscribers - one allocation per operation.
+template<class Async, class Results = throwing_results<Async>>
+struct async_state : ImplementsDefault<typename async_traits<Async>::completed_handler_type>
+{
+    typedef typename Results::result_type result_type;
+    typedef typename async_traits<Async>::completed_handler_type completed_handler_type;
+    typedef Rx::subscriber<result_type> subscriber_type;
+
+    explicit async_state(Async const & aop)
+        : aop(aop)
+        , connected(false)
+        , subscribers(0)
+    {
+    }
+
+    void add(subscriber_type out) {
+        ++subscribers;
+        replay.add(out);
+        if (replay.is_done() || connected.exchange(true)) {
+            return;
+        }
+        // the same check as await_ready - an operation that has already
+        // finished completes inline without registering the handler
+        if (aop.Status() == AsyncStatus::Completed) {
+            complete(AsyncStatus::Completed);
+            return;
+        }
+        // may call abi_Invoke synchronously when the operation has finished since
+        check(aop->put_Completed(static_cast<Abi<completed_handler_type>*>(this)));
+    }
+
+    void remove() {
+        replay.sweep();
+        if (--subscribers == 0 && !replay.is_done()) {
+            cancel_async(aop);
+        }
+    }
+
+    virtual HRESULT __stdcall abi_Invoke(AbiArgIn<Async>, AsyncStatus status) noexcept override {
+        return call([&] {
+            complete(status);
+        });
+    }
+
+private:
+    void complete(AsyncStatus status) {
+        Rx::maybe<result_type> result;
+        std::exception_ptr error;
+        Results::complete(aop, status, result, error);
+        close_async(aop);
+        replay.complete(std::move(result), error);
+    }
+
+    Async aop;
+    replay_one<result_type> replay;
+    std::atomic<bool> connected;
+    std::atomic<int> subscribers;
+};
+
+template<class Async, class Results = throwing_results<Async>>
+struct async_source : public rxcpp::sources::source_base<typename Results::result_type>
+{
+    typedef async_state<Async, Results> state_type;
+
+    explicit async_source(Async const & aop)
+    {
+        attach(state, new state_type(aop));
+    }
+
+    template<class Subscriber>
+    void on_subscribe(Subscriber o) const {
+        auto that = state;
+        that->add(o.as_dynamic());
+        o.add([that]() {
+            that->remove();
+        });
+    }
+
+    ComPtr<state_type> state;
+};
+
+}
+
+// statically typed observable over a single WinRT async result.
+template<class Async>
+using async_observable = Rx::observable<typename detail::async_traits<Async>::result_type, detail::async_source<Async>>;
+
+template<class Async>
+auto make_async_observable(const Async& aop) -> async_observable<Async> {
+    return async_observable<Async>(detail::async_source<Async>(aop));
+}
+
+template<class Result>
+auto from_async(const Windows::Foundation::IAsyncOperation<Result>& aop) -> async_observable<Windows::Foundation::IAsyncOperation<Result>> {
+    return make_async_observable(aop);
 }
 
 template<class Result, class Progress>
-auto from_async(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop) -> Rx::observable<Result> {
-    return Rx::create<Result>(
-        [=](Rx::subscriber<Result>& out) {
-            aop.Completed([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const & completed, AsyncStatus const &) {
-                try { out.on_next(completed.GetResults()); }
-                catch (...) { out.on_error(std::current_exception()); }
-                out.on_completed();
-            });
-            // no cancellation :(
-        })
-        .as_dynamic()
-        .publish()
-        .ref_count();
+auto from_async(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop) -> async_observable<Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>> {
+    return make_async_observable(aop);
+}
+
+inline auto from_async(const Windows::Foundation::IAsyncAction& aop) -> async_observable<Windows::Foundation::IAsyncAction> {
+    return make_async_observable(aop);
+}
+
+template<class Progress>
+auto from_async(const Windows::Foundation::IAsyncActionWithProgress<Progress>& aop) -> async_observable<Windows::Foundation::IAsyncActionWithProgress<Progress>> {
+    return make_async_observable(aop);
 }
 
 template<class Async>
-auto start_async(Async&& a) -> decltype(from_async(a())) {
+auto start_async(Async&& a) {
     return Rx::defer(
         [=]() {
             return from_async(a());
         });
 }
 
+// the outcome of an operation as a value. a failure is carried as the
+// operation's HRESULT instead of an exception.
+template<class T>
+struct async_result
+{
+    async_result()
+        : error(S_OK)
+    {
+    }
+
+    explicit async_result(T value)
+        : error(S_OK)
+        , value(std::move(value))
+    {
+    }
+
+    // not a constructor, which would collide with the one above when T is
+    // HRESULT's type
+    static async_result failure(HRESULT error) {
+        async_result r;
+        r.error = error;
+        return r;
+    }
+
+    bool succeeded() const {
+        return SUCCEEDED(error) && !value.empty();
+    }
+
+    // throws the carried error - for the rare consumer that wants it back as an exception
+    const T& get() const {
+        if (!succeeded()) {
+            throw Modern::Exception(FAILED(error) ? error : E_ILLEGAL_METHOD_CALL);
+        }
+        return value.get();
+    }
+
+    HRESULT error;
+    Rx::maybe<T> value;
+};
+
 namespace detail {
 
-template<class Result, class Progress>
-struct r_and_p 
+// every outcome, including cancellation, is an on_next. the failure is read
+// from IAsyncInfo::ErrorCode and the results through the ABI, so nothing is
+// thrown.
+template<class Async>
+struct hresult_results
 {
-    Rx::maybe<Result> r;
-    Rx::maybe<Progress> p;
-    Rx::subject<Result> rsub;
-    Rx::subject<Progress> psub;
+    typedef typename async_traits<Async>::result_type value_type;
+    typedef async_result<value_type> result_type;
+
+    static void complete(Async const & aop, AsyncStatus status, Rx::maybe<result_type>& result, std::exception_ptr&) {
+        if (status == AsyncStatus::Canceled) {
+            result.reset(result_type::failure(HRESULT_FROM_WIN32(ERROR_CANCELLED)));
+            return;
+        }
+        if (status == AsyncStatus::Error) {
+            HRESULT hr = E_FAIL;
+            Windows::IAsyncInfo info;
+            if (SUCCEEDED(get(aop)->QueryInterface(__uuidof(Abi<Windows::IAsyncInfo>), reinterpret_cast<void**>(set(info))))) {
+                info->get_ErrorCode(&hr);
+            }
+            result.reset(result_type::failure(FAILED(hr) ? hr : E_FAIL));
+            return;
+        }
+        value_type value = Argument<value_type>::Empty();
+        auto hr = async_traits<Async>::try_get_results(aop, value);
+        result.reset(FAILED(hr) ? result_type::failure(hr) : result_type(std::move(value)));
+    }
 };
 
 }
 
-template<class Result, class Progress>
-auto from_async_with_progress(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop) -> std::tuple<Rx::observable<Result>, Rx::observable<Progress>> {
-    auto state = make_shared < detail::r_and_p<Result, Progress> >();
+template<class Async>
+using async_result_observable = Rx::observable<typename detail::hresult_results<Async>::result_type, detail::async_source<Async, detail::hresult_results<Async>>>;
 
-    aop.Progress([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const &, Progress const & progress) {
-        auto ps = state->psub.get_subscriber();
-        state->p.reset(progress);
-        ps.on_next(progress);
-    });
+// from_async for error storms - emits one async_result and completes, never
+// calls on_error. a failing backend then costs no throw, catch or rethrow.
+template<class Async>
+auto from_async_result(const Async& aop) -> async_result_observable<Async> {
+    return async_result_observable<Async>(detail::async_source<Async, detail::hresult_results<Async>>(aop));
+}
 
-    aop.Completed([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const & completed, AsyncStatus const &) {
-        auto rs = state->rsub.get_subscriber();
-        auto ps = state->psub.get_subscriber();
-        try { state->r.reset(completed.GetResults()); }
-        catch (...) { rs.on_error(std::current_exception()); }
-        rs.on_next(state->r.get());
-        rs.on_completed();
-        ps.on_completed();
-    });
+template<class Async>
+auto start_async_result(Async&& a) {
+    return Rx::defer(
+        [=]() {
+            return from_async_result(a());
+        });
+}
 
-    auto result = Rx::defer(
-        [=]() -> Rx::observable<Result> {
-            auto result = state->rsub
-                .get_observable();
-            if (!state->r.empty()) {
-                return result
-                    .start_with(state->r.get());
+namespace detail {
+
+// one Completed handler registered with every operation in the group, one
+// result array and one counter. the sender pointer passed to abi_Invoke
+// finds the operation's slot.
+template<class Async, bool Any>
+struct when_state : ImplementsDefault<typename async_traits<Async>::completed_handler_type>
+{
+    typedef typename async_traits<Async>::result_type result_type;
+    typedef typename async_traits<Async>::completed_handler_type completed_handler_type;
+    typedef typename std::conditional<Any, std::pair<size_t, result_type>, std::vector<result_type>>::type value_type;
+    typedef Rx::subscriber<value_type> subscriber_type;
+
+    explicit when_state(std::vector<Async> operations)
+        : ops(std::move(operations))
+        , remaining(ops.size())
+        , connected(false)
+        , claimed(false)
+        , subscribers(0)
+    {
+        if (!Any) {
+            results.resize(ops.size(), Argument<result_type>::Empty());
+        }
+        senders.reserve(ops.size());
+        for (size_t i = 0; i < ops.size(); ++i) {
+            senders.emplace_back(static_cast<const void*>(get(ops[i])), i);
+        }
+        std::sort(senders.begin(), senders.end());
+    }
+
+    void add(subscriber_type out) {
+        ++subscribers;
+        replay.add(out);
+        if (replay.is_done() || connected.exchange(true)) {
+            return;
+        }
+        if (ops.empty()) {
+            Rx::maybe<value_type> empty;
+            empty.reset(value_type());
+            replay.complete(std::move(empty), nullptr);
+            return;
+        }
+        for (size_t i = 0; i < ops.size() && !claimed.load(); ++i) {
+            if (ops[i].Status() == AsyncStatus::Completed) {
+                complete(i, AsyncStatus::Completed);
+                continue;
             }
-            return result;
-        })
-        .as_dynamic();
+            check(ops[i]->put_Completed(static_cast<Abi<completed_handler_type>*>(this)));
+        }
+    }
 
-    auto progress = Rx::defer(
-        [=]() -> Rx::observable<Progress> {
-            auto result = state->psub
-                .get_observable();
-            if (!state->p.empty()) {
-                return result
-                    .start_with(state->p.get());
+    void remove() {
+        replay.sweep();
+        if (--subscribers == 0 && !replay.is_done()) {
+            cancel_all();
+        }
+    }
+
+    virtual HRESULT __stdcall abi_Invoke(AbiArgIn<Async> sender, AsyncStatus status) noexcept override {
+        return call([&] {
+            auto key = std::make_pair(static_cast<const void*>(sender), size_t(0));
+            auto it = std::lower_bound(senders.begin(), senders.end(), key);
+            if (it != senders.end() && it->first == key.first) {
+                complete(it->second, status);
             }
-            return result;
-        })
-        .as_dynamic();
+        });
+    }
+
+private:
+    void cancel_all() {
+        for (auto& aop : ops) {
+            cancel_async(aop);
+        }
+    }
+
+    void complete(size_t index, AsyncStatus status) {
+        result_type value = Argument<result_type>::Empty();
+        std::exception_ptr error;
+        // the losers' results are not needed
+        if (!claimed.load()) {
+            if (status == AsyncStatus::Canceled) {
+                error = make_canceled_error();
+            }
+            else {
+                try { value = async_traits<Async>::get_results(ops[index]); }
+                catch (...) { error = std::current_exception(); }
+            }
+        }
+        close_async(ops[index]);
+        finish(index, std::move(value), error, std::integral_constant<bool, Any>());
+    }
+
+    // when_any - the first operation to finish decides
+    void finish(size_t index, result_type value, std::exception_ptr error, std::true_type) {
+        if (claimed.exchange(true)) {
+            return;
+        }
+        cancel_all();
+        Rx::maybe<value_type> result;
+        if (!error) {
+            result.reset(value_type(index, std::move(value)));
+        }
+        replay.complete(std::move(result), error);
+    }
+
+    // when_all - the last success or the first failure decides
+    void finish(size_t index, result_type value, std::exception_ptr error, std::false_type) {
+        if (error) {
+            if (claimed.exchange(true)) {
+                return;
+            }
+            cancel_all();
+            replay.complete(Rx::maybe<value_type>(), error);
+            return;
+        }
+        if (claimed.load()) {
+            return;
+        }
+        results[index] = std::move(value);
+        if (--remaining != 0 || claimed.exchange(true)) {
+            return;
+        }
+        Rx::maybe<value_type> result;
+        result.reset(std::move(results));
+        replay.complete(std::move(result), nullptr);
+    }
+
+    const std::vector<Async> ops;
+    std::vector<std::pair<const void*, size_t>> senders;
+    std::vector<result_type> results;
+    replay_one<value_type> replay;
+    std::atomic<size_t> remaining;
+    std::atomic<bool> connected;
+    std::atomic<bool> claimed;
+    std::atomic<int> subscribers;
+};
+
+template<class Async, bool Any>
+struct when_source : public rxcpp::sources::source_base<typename when_state<Async, Any>::value_type>
+{
+    typedef when_state<Async, Any> state_type;
+
+    explicit when_source(std::vector<Async> ops)
+    {
+        attach(state, new state_type(std::move(ops)));
+    }
+
+    template<class Subscriber>
+    void on_subscribe(Subscriber o) const {
+        auto that = state;
+        that->add(o.as_dynamic());
+        o.add([that]() {
+            that->remove();
+        });
+    }
+
+    ComPtr<state_type> state;
+};
+
+template<class Range>
+using range_async_t = std::decay_t<decltype(*std::begin(std::declval<Range&>()))>;
 
-    return std::make_tuple(result, progress);
 }
 
-template<class Async, 
-    class AOP = std::result_of_t<Async()>, 
-    class Tuple = decltype(from_async_with_progress(AOP())), 
-    class Result = Rx::observable<std::decay_t<Tuple>>>
-auto start_async_with_progress(Async&& a) -> Result {
-    return Rx::create<Tuple>(
-        [=](Rx::subscriber<Tuple>& out) {
-            out.on_next(from_async_with_progress(a()));
+template<class Async>
+using when_all_observable = Rx::observable<typename detail::when_state<Async, false>::value_type, detail::when_source<Async, false>>;
+
+template<class Async>
+using when_any_observable = Rx::observable<typename detail::when_state<Async, true>::value_type, detail::when_source<Async, true>>;
+
+// emits the results of all the operations, in the order of the range, once
+// the last one completes. the first failure cancels the rest.
+template<class Range, class Async = detail::range_async_t<Range>>
+auto when_all(const Range& operations) -> when_all_observable<Async> {
+    return when_all_observable<Async>(detail::when_source<Async, false>(std::vector<Async>(std::begin(operations), std::end(operations))));
+}
+
+// emits the index and result of the first operation to finish and cancels
+// the others. fails if the first to finish failed.
+template<class Range, class Async = detail::range_async_t<Range>>
+auto when_any(const Range& operations) -> when_any_observable<Async> {
+    std::vector<Async> ops(std::begin(operations), std::end(operations));
+    if (ops.empty()) {
+        throw std::invalid_argument("when_any requires at least one operation");
+    }
+    return when_any_observable<Async>(detail::when_source<Async, true>(std::move(ops)));
+}
+
+// distinguishable by type, and still reported by print_error as an HRESULT
+struct async_timeout : public Modern::Exception
+{
+    async_timeout()
+        : Modern::Exception(HRESULT_FROM_WIN32(ERROR_TIMEOUT))
+    {
+    }
+};
+
+namespace detail {
+
+template<class T>
+struct deadline_state
+{
+    explicit deadline_state(Rx::subscriber<T> out)
+        : out(std::move(out))
+        , done(false)
+    {
+    }
+
+    void on_next(const T& t) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (!done) {
+            out.on_next(t);
+        }
+    }
+    void on_error(std::exception_ptr e) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (!done) {
+            done = true;
+            out.on_error(e);
+        }
+    }
+    void on_completed() {
+        std::unique_lock<std::mutex> guard(lock);
+        if (!done) {
+            done = true;
             out.on_completed();
+        }
+    }
+
+private:
+    Rx::subscriber<T> out;
+    std::mutex lock;
+    bool done;
+};
+
+template<class Source, class Deadline>
+auto with_deadline(Source source, Deadline deadline, std::shared_ptr<timer_wheel> wheel) {
+    typedef typename Source::value_type value_type;
+    return Rx::create<value_type>(
+        [=](Rx::subscriber<value_type> out) {
+            auto state = std::make_shared<deadline_state<value_type>>(out);
+
+            composite_subscription source_lifetime;
+            out.add(source_lifetime);
+
+            auto timer = wheel->insert(deadline(), [state, source_lifetime]() {
+                // unsubscribing from from_async cancels the operation
+                source_lifetime.unsubscribe();
+                state->on_error(std::make_exception_ptr(async_timeout()));
+            });
+            out.add([wheel, timer]() {
+                wheel->cancel(timer);
+            });
+
+            source.subscribe(
+                source_lifetime,
+                [state](const value_type& t) {
+                    state->on_next(t);
+                },
+                [state](std::exception_ptr e) {
+                    state->on_error(e);
+                },
+                [state]() {
+                    state->on_completed();
+                });
         });
 }
 
-template<template<class> class Items, class Item>
-auto to_vector(Items<Item> items) {
-    std::vector<Item> copy;
-    for (Item const & item : items) {
-        copy.push_back(item);
-    }
-    return copy;
+}
+
+// fails with async_timeout and cancels the operation when it has not finished
+// by the deadline. every deadline shares one timer_wheel, so thousands of
+// outstanding operations still cost a single OS timer.
+inline auto with_deadline(timer_wheel::clock_type::time_point deadline, std::shared_ptr<timer_wheel> wheel = shared_timer_wheel()) {
+    return [=](auto source) {
+        return detail::with_deadline(source, [deadline]() { return deadline; }, wheel);
+    };
+}
+
+// the deadline is measured from each subscription
+inline auto with_deadline(timer_wheel::clock_type::duration timeout, std::shared_ptr<timer_wheel> wheel = shared_timer_wheel()) {
+    return [=](auto source) {
+        return detail::with_deadline(source, [timeout]() { return timer_wheel::clock_type::now() + timeout; }, wheel);
+    };
+}
+
+template<class Result>
+auto from_async(const Windows::Foundation::IAsyncOperation<Result>& aop, timer_wheel::clock_type::time_point deadline) {
+    return with_deadline(deadline)(from_async(aop));
+}
+
+template<class Result, class Progress>
+auto from_async(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop, timer_wheel::clock_type::time_point deadline) {
+    return with_deadline(deadline)(from_async(aop));
+}
+
+inline auto from_async(const Windows::Foundation::IAsyncAction& aop, timer_wheel::clock_type::time_point deadline) {
+    return with_deadline(deadline)(from_async(aop));
+}
+
+template<class Progress>
+auto from_async(const Windows::Foundation::IAsyncActionWithProgress<Progress>& aop, timer_wheel::clock_type::time_point deadline) {
+    return with_deadline(deadline)(from_async(aop));
+}
+
+namespace detail {
+
+// only coordinations that know their thread can skip the hop
+template<class Coordination>
+bool has_thread_access(const Coordination&) {
+    return false;
+}
+
+inline bool has_thread_access(const core_dispatcher_coordination& cn) {
+    return cn.has_thread_access();
+}
+
+// delivers the result and completion of a single result source as one item
+// scheduled on the coordination's worker - or inline when the completion
+// already runs on the target thread.
+template<class Source, class Coordination>
+auto deliver_on(Source source, Coordination cn) {
+    typedef typename Source::value_type value_type;
+    return Rx::create<value_type>(
+        [=](Rx::subscriber<value_type> out) {
+            auto worker = cn.create_coordinator(out.get_subscription()).get_worker();
+            auto result = std::make_shared<Rx::maybe<value_type>>();
+
+            composite_subscription lifetime;
+            out.add(lifetime);
+
+            source.subscribe(
+                lifetime,
+                [result](const value_type& v) {
+                    result->reset(v);
+                },
+                [=](std::exception_ptr e) {
+                    if (has_thread_access(cn)) {
+                        out.on_error(e);
+                        return;
+                    }
+                    worker.schedule(Rx::make_schedulable(worker, [out, e](const Rx::schedulable&) {
+                        out.on_error(e);
+                    }));
+                },
+                [=]() {
+                    auto deliver = [out, result]() {
+                        if (!result->empty()) {
+                            out.on_next(result->get());
+                        }
+                        out.on_completed();
+                    };
+                    if (has_thread_access(cn)) {
+                        deliver();
+                        return;
+                    }
+                    worker.schedule(Rx::make_schedulable(worker, [deliver](const Rx::schedulable&) {
+                        deliver();
+                    }));
+                });
+        });
+}
+
+}
+
+// the result is scheduled straight onto the coordination from the Completed
+// handler, instead of from_async(aop).observe_on(cn) queueing it a second time.
+//
+//     Rx::from_async(client.RetrieveFeedAsync(uri), Rx::identity_core_dispatcher())
+//
+template<class Result, class Coordination, class = std::enable_if_t<rxcpp::is_coordination<Coordination>::value>>
+auto from_async(const Windows::Foundation::IAsyncOperation<Result>& aop, Coordination cn) {
+    return detail::deliver_on(from_async(aop), std::move(cn));
+}
+
+template<class Result, class Progress, class Coordination, class = std::enable_if_t<rxcpp::is_coordination<Coordination>::value>>
+auto from_async(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop, Coordination cn) {
+    return detail::deliver_on(from_async(aop), std::move(cn));
+}
+
+template<class Coordination, class = std::enable_if_t<rxcpp::is_coordination<Coordination>::value>>
+auto from_async(const Windows::Foundation::IAsyncAction& aop, Coordination cn) {
+    return detail::deliver_on(from_async(aop), std::move(cn));
+}
+
+template<class Progress, class Coordination, class = std::enable_if_t<rxcpp::is_coordination<Coordination>::value>>
+auto from_async(const Windows::Foundation::IAsyncActionWithProgress<Progress>& aop, Coordination cn) {
+    return detail::deliver_on(from_async(aop), std::move(cn));
+}
+
+template<class Async, class Coordination, class = std::enable_if_t<rxcpp::is_coordination<Coordination>::value>>
+auto start_async(Async&& a, Coordination cn) {
+    return Rx::defer(
+        [=]() {
+            return from_async(a(), cn);
+        });
+}
+
+// lock-free token bucket. copies share one bucket, so several pipelines can
+// draw on the same budget. this is the generic cell rate algorithm - the
+// whole bucket is a single atomic 'theoretical arrival time' that each token
+// pushes forward by one interval.
+class token_bucket
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+private:
+    struct state_type
+    {
+        state_type(clock_type::duration interval, clock_type::duration tolerance)
+            : interval(interval)
+            , tolerance(tolerance)
+            , tat(0)
+        {
+        }
+
+        const clock_type::duration interval;
+        const clock_type::duration tolerance;
+        std::atomic<clock_type::rep> tat;
+    };
+
+    std::shared_ptr<state_type> state;
+
+public:
+    token_bucket(double tokens_per_second, double burst)
+    {
+        if (!(tokens_per_second > 0) || burst < 1) {
+            throw std::invalid_argument("token_bucket requires tokens_per_second > 0 and burst >= 1");
+        }
+        auto interval = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0 / tokens_per_second));
+        if (interval < clock_type::duration(1)) {
+            interval = clock_type::duration(1);
+        }
+        state = std::make_shared<state_type>(interval, std::chrono::duration_cast<clock_type::duration>(interval * burst));
+    }
+
+    bool try_acquire(clock_type::time_point now = clock_type::now()) const {
+        auto n = now.time_since_epoch().count();
+        auto tat = state->tat.load();
+        for (;;) {
+            auto next = (std::max)(tat, n) + state->interval.count();
+            if (next - n > state->tolerance.count()) {
+                return false;
+            }
+            if (state->tat.compare_exchange_weak(tat, next)) {
+                return true;
+            }
+        }
+    }
+
+    // takes the next token even when it is not yet due and returns when it
+    // is due - waiters are queued in the bucket itself, in order, rather than
+    // polling
+    clock_type::time_point reserve(clock_type::time_point now = clock_type::now()) const {
+        auto n = now.time_since_epoch().count();
+        auto tat = state->tat.load();
+        for (;;) {
+            auto next = (std::max)(tat, n) + state->interval.count();
+            if (state->tat.compare_exchange_weak(tat, next)) {
+                return clock_type::time_point(clock_type::duration((std::max)(next - state->tolerance.count(), n)));
+            }
+        }
+    }
+
+    // how long until try_acquire can succeed
+    clock_type::duration wait_time(clock_type::time_point now = clock_type::now()) const {
+        auto n = now.time_since_epoch().count();
+        auto wait = (std::max)(state->tat.load(), n) + state->interval.count() - state->tolerance.count() - n;
+        return clock_type::duration((std::max)(wait, clock_type::rep(0)));
+    }
+};
+
+inline HRESULT hresult_of(std::exception_ptr ep) {
+    try { std::rethrow_exception(ep); }
+    catch (const Modern::Exception& ex) { return ex.Result; }
+    catch (const std::bad_alloc&) { return E_OUTOFMEMORY; }
+    catch (...) { return E_FAIL; }
+}
+
+// transient failures - timeouts, dropped connections and the http statuses
+// that mean 'try again later'. everything else, including cancellation, is fatal.
+inline bool is_retryable(HRESULT hr) {
+    if (HRESULT_FACILITY(hr) == FACILITY_HTTP) {
+        auto status = HRESULT_CODE(hr);
+        // request timeout, too many requests and the 5xx server errors
+        return status == 408 || status == 429 || (status >= 500 && status != 501 && status != 505);
+    }
+    // HRESULT_FROM_WIN32 is an inline function in the SDK, so the case labels
+    // use the macro form, which is a constant expression
+    switch (hr) {
+    case __HRESULT_FROM_WIN32(ERROR_TIMEOUT):
+    case __HRESULT_FROM_WIN32(WAIT_TIMEOUT):
+    case __HRESULT_FROM_WIN32(ERROR_SEM_TIMEOUT):
+    case __HRESULT_FROM_WIN32(ERROR_CONNECTION_ABORTED):
+    case __HRESULT_FROM_WIN32(ERROR_CONNECTION_REFUSED):
+    case __HRESULT_FROM_WIN32(ERROR_NETWORK_UNREACHABLE):
+    case __HRESULT_FROM_WIN32(ERROR_HOST_UNREACHABLE):
+    case __HRESULT_FROM_WIN32(ERROR_NETNAME_DELETED):
+    case __HRESULT_FROM_WIN32(12002): // ERROR_INTERNET_TIMEOUT
+    case __HRESULT_FROM_WIN32(12029): // ERROR_INTERNET_CANNOT_CONNECT
+    case __HRESULT_FROM_WIN32(12030): // ERROR_INTERNET_CONNECTION_ABORTED
+    case __HRESULT_FROM_WIN32(12031): // ERROR_INTERNET_CONNECTION_RESET
+    case RPC_E_DISCONNECTED:
+    case E_PENDING:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline bool is_retryable_error(std::exception_ptr ep) {
+    return is_retryable(hresult_of(ep));
+}
+
+struct retry_policy
+{
+    typedef std::chrono::steady_clock clock_type;
+
+    retry_policy()
+        : max_retries(3)
+        , base(std::chrono::milliseconds(100))
+        , cap(std::chrono::seconds(10))
+        , budget(1.0, 10.0)
+        , retryable(&is_retryable_error)
+    {
+    }
+
+    int max_retries;
+    // the delay before retry n is uniform in [0, min(cap, base * 2^n)]
+    clock_type::duration base;
+    clock_type::duration cap;
+    // every retry takes a token. share one bucket across the pipelines that
+    // call the same backend to bound the retry rate during an outage.
+    token_bucket budget;
+    std::function<bool(std::exception_ptr)> retryable;
+};
+
+namespace detail {
+
+// ties the lifetime of an inner subscription to outer. it ends when outer
+// ends, and is removed from outer when it ends first so that outer does not
+// collect the lifetimes of every operation it has run.
+inline composite_subscription inner_lifetime(const composite_subscription& outer, composite_subscription inner = composite_subscription()) {
+    auto token = outer.add(inner);
+    inner.add([outer, token]() {
+        outer.remove(token);
+    });
+    return inner;
+}
+
+template<class Source, class T = typename Source::value_type>
+struct retry_backoff_state : public std::enable_shared_from_this<retry_backoff_state<Source, T>>
+{
+    retry_backoff_state(Source source, retry_policy policy, Rx::worker worker, Rx::subscriber<T> out)
+        : source(std::move(source))
+        , policy(std::move(policy))
+        , worker(std::move(worker))
+        , out(std::move(out))
+        , attempt(0)
+        , random(std::random_device()())
+    {
+    }
+
+    void subscribe() {
+        auto that = this->shared_from_this();
+        auto lifetime = inner_lifetime(out.get_subscription());
+
+        source.subscribe(
+            lifetime,
+            [that](const T& t) {
+                that->attempt = 0;
+                that->out.on_next(t);
+            },
+            [that](std::exception_ptr e) {
+                that->retry(e);
+            },
+            [that]() {
+                that->out.on_completed();
+            });
+    }
+
+private:
+    void retry(std::exception_ptr e) {
+        if (attempt >= policy.max_retries || !policy.retryable(e) || !policy.budget.try_acquire()) {
+            out.on_error(e);
+            return;
+        }
+
+        // full jitter
+        auto limit = policy.cap;
+        if (attempt < 30 && policy.base * (int64_t(1) << attempt) < limit) {
+            limit = policy.base * (int64_t(1) << attempt);
+        }
+        ++attempt;
+        std::uniform_int_distribution<retry_policy::clock_type::rep> jitter(0, (std::max)(limit.count(), retry_policy::clock_type::rep(0)));
+        auto delay = retry_policy::clock_type::duration(jitter(random));
+
+        auto that = this->shared_from_this();
+        worker.schedule(worker.now() + delay, Rx::make_schedulable(worker, [that](const Rx::schedulable&) {
+            that->subscribe();
+        }));
+    }
+
+    Source source;
+    const retry_policy policy;
+    Rx::worker worker;
+    Rx::subscriber<T> out;
+    int attempt;
+    std::mt19937 random;
+};
+
+}
+
+// resubscribes after a transient error, waiting an exponentially growing,
+// fully jittered delay on the coordination's worker. fatal errors, an
+// exhausted retry count or an empty retry budget are passed through.
+//
+//     Rx::start_async([=]() { return client.RetrieveFeedAsync(uri); })
+//         | Rx::retry_backoff(policy, Rx::identity_one_worker(Rx::make_thread_pool()));
+//
+template<class Coordination>
+auto retry_backoff(retry_policy policy, Coordination cn) {
+    return [=](auto source) {
+        typedef std::decay_t<decltype(source)> source_type;
+        typedef typename source_type::value_type value_type;
+        return Rx::create<value_type>(
+            [=](Rx::subscriber<value_type> out) {
+                auto worker = cn.create_coordinator(out.get_subscription()).get_worker();
+                std::make_shared<detail::retry_backoff_state<source_type>>(source, policy, worker, out)->subscribe();
+            });
+    };
+}
+
+inline auto retry_backoff(retry_policy policy = retry_policy()) {
+    return retry_backoff(std::move(policy), identity_one_worker(make_thread_pool()));
+}
+
+// a live latency percentile for hedging thresholds. latencies are counted in
+// quarter-octave buckets, so record is a couple of atomic increments and the
+// estimate is within ~19% of the true percentile. old samples are halved
+// away once the window fills, so the estimate follows the backend.
+class latency_estimate
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+private:
+    static const int buckets = 128;
+    static const int steps_per_octave = 4;
+
+    latency_estimate(const latency_estimate&);
+
+    const double percentile;
+    const clock_type::duration fallback;
+    const long window;
+    const long min_samples;
+    std::atomic<long> counts[buckets];
+    std::atomic<long> total;
+
+    static int bucket_of(clock_type::duration latency) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        if (us < 1) {
+            return 0;
+        }
+        return (std::min)(buckets - 1, static_cast<int>(std::log2(static_cast<double>(us)) * steps_per_octave));
+    }
+
+    static clock_type::duration upper_bound(int bucket) {
+        return std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double, std::micro>(std::exp2(static_cast<double>(bucket + 1) / steps_per_octave)));
+    }
+
+public:
+    // fallback is used until min_samples latencies have been recorded
+    latency_estimate(double percentile, clock_type::duration fallback, long window = 10000, long min_samples = 100)
+        : percentile(percentile)
+        , fallback(fallback)
+        , window(window)
+        , min_samples(min_samples)
+        , total(0)
+    {
+        if (!(percentile > 0 && percentile < 1) || window < min_samples) {
+            throw std::invalid_argument("latency_estimate requires 0 < percentile < 1 and window >= min_samples");
+        }
+        for (auto& count : counts) {
+            count = 0;
+        }
+    }
+
+    void record(clock_type::duration latency) {
+        ++counts[bucket_of(latency)];
+        if (++total < window) {
+            return;
+        }
+        // decay - racing records are only ever slightly miscounted
+        long kept = 0;
+        for (auto& count : counts) {
+            auto half = count.load() / 2;
+            count = half;
+            kept += half;
+        }
+        total = kept;
+    }
+
+    clock_type::duration threshold() const {
+        auto n = total.load();
+        if (n < min_samples) {
+            return fallback;
+        }
+        auto target = static_cast<long>(percentile * n);
+        long seen = 0;
+        for (int bucket = 0; bucket < buckets; ++bucket) {
+            seen += counts[bucket].load();
+            if (seen > target) {
+                return upper_bound(bucket);
+            }
+        }
+        return upper_bound(buckets - 1);
+    }
+};
+
+struct hedge_counters
+{
+    hedge_counters()
+        : started(0)
+        , fired(0)
+        , won(0)
+    {
+    }
+
+    std::atomic<long> started;
+    // a second operation was issued
+    std::atomic<long> fired;
+    // and it finished first
+    std::atomic<long> won;
+};
+
+namespace detail {
+
+template<class T>
+struct hedge_state : public std::enable_shared_from_this<hedge_state<T>>
+{
+    typedef timer_wheel::clock_type clock_type;
+
+    hedge_state(Rx::observable<T> attempt, std::shared_ptr<hedge_counters> counters, std::shared_ptr<latency_estimate> estimate, std::shared_ptr<timer_wheel> wheel, Rx::subscriber<T> out)
+        : attempt(std::move(attempt))
+        , counters(std::move(counters))
+        , estimate(std::move(estimate))
+        , wheel(std::move(wheel))
+        , out(std::move(out))
+        , running(0)
+        , done(false)
+    {
+    }
+
+    void start(clock_type::duration after) {
+        // written before either attempt can finish, and only read after
+        started_at = clock_type::now();
+        auto weak = std::weak_ptr<hedge_state>(this->shared_from_this());
+        auto t = wheel->insert(started_at + after, [weak]() {
+            if (auto that = weak.lock()) {
+                that->fire();
+            }
+        });
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            timer = t;
+        }
+        ++counters->started;
+        subscribe(0);
+    }
+
+    void stop() {
+        timer_wheel::timer t;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            swap(t, timer);
+        }
+        wheel->cancel(t);
+    }
+
+private:
+    void fire() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return;
+            }
+        }
+        ++counters->fired;
+        subscribe(1);
+    }
+
+    void subscribe(int which) {
+        auto that = this->shared_from_this();
+
+        composite_subscription lifetime;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return;
+            }
+            attempts[which] = lifetime;
+            ++running;
+        }
+        inner_lifetime(out.get_subscription(), lifetime);
+
+        attempt.subscribe(
+            lifetime,
+            [that, which](const T& t) {
+                if (that->win(which)) {
+                    that->out.on_next(t);
+                    that->out.on_completed();
+                }
+            },
+            [that](std::exception_ptr e) {
+                that->fail(e);
+            },
+            [that, which]() {
+                if (that->win(which)) {
+                    that->out.on_completed();
+                }
+            });
+    }
+
+    // the first attempt to finish cancels the other
+    bool win(int which) {
+        composite_subscription other;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return false;
+            }
+            done = true;
+            other = attempts[1 - which];
+        }
+        stop();
+        other.unsubscribe();
+        if (estimate) {
+            // what the caller waited, from the first attempt. timing a hedge
+            // from its own start would feed shorter samples back into the
+            // threshold, firing more hedges and shortening them further.
+            estimate->record(clock_type::now() - started_at);
+        }
+        if (which == 1) {
+            ++counters->won;
+        }
+        return true;
+    }
+
+    // a failure only ends the hedge when no other attempt can still succeed
+    void fail(std::exception_ptr e) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done || --running > 0) {
+                return;
+            }
+            done = true;
+        }
+        stop();
+        out.on_error(e);
+    }
+
+    Rx::observable<T> attempt;
+    std::shared_ptr<hedge_counters> counters;
+    std::shared_ptr<latency_estimate> estimate;
+    std::shared_ptr<timer_wheel> wheel;
+    Rx::subscriber<T> out;
+
+    clock_type::time_point started_at;
+
+    std::mutex lock;
+    composite_subscription attempts[2];
+    timer_wheel::timer timer;
+    int running;
+    bool done;
+};
+
+template<class Factory, class Threshold>
+auto hedge(Factory factory, Threshold threshold, std::shared_ptr<hedge_counters> counters, std::shared_ptr<latency_estimate> estimate, std::shared_ptr<timer_wheel> wheel) {
+    auto attempt = start_async(factory).as_dynamic();
+    typedef typename decltype(attempt)::value_type value_type;
+    return Rx::create<value_type>(
+        [=](Rx::subscriber<value_type> out) {
+            auto state = std::make_shared<hedge_state<value_type>>(attempt, counters, estimate, wheel, out);
+            out.add([state]() {
+                state->stop();
+            });
+            state->start(threshold());
+        });
+}
+
+}
+
+// for idempotent calls only - when the operation from factory has not
+// finished after the threshold an identical second one is started, the first
+// to finish wins and the other is canceled.
+//
+//     Rx::hedge([=]() { return client.RetrieveFeedAsync(uri); }, chrono::milliseconds(300), counters);
+//
+template<class Factory>
+auto hedge(Factory factory, timer_wheel::clock_type::duration after, std::shared_ptr<hedge_counters> counters = std::make_shared<hedge_counters>(), std::shared_ptr<timer_wheel> wheel = shared_timer_wheel()) {
+    return detail::hedge(std::move(factory), [after]() { return after; }, std::move(counters), nullptr, std::move(wheel));
+}
+
+// the threshold follows the live percentile of the winning latencies, eg.
+//
+//     auto p95 = std::make_shared<Rx::latency_estimate>(0.95, chrono::milliseconds(300));
+//
+template<class Factory>
+auto hedge(Factory factory, std::shared_ptr<latency_estimate> estimate, std::shared_ptr<hedge_counters> counters = std::make_shared<hedge_counters>(), std::shared_ptr<timer_wheel> wheel = shared_timer_wheel()) {
+    return detail::hedge(std::move(factory), [estimate]() { return estimate->threshold(); }, std::move(counters), estimate, std::move(wheel));
+}
+
+// delays the subscription - and so the start_async factory call - until the
+// bucket has a token. results are not delayed. share one bucket between
+// pipelines to hold them all under one quota.
+//
+//     auto quota = Rx::token_bucket(10, 20);
+//     uris.map([=](Uri uri) { return Rx::start_async([=]() { return client.RetrieveFeedAsync(uri); }) | Rx::rate_limit(quota); })
+//         | Rx::merge_async(4);
+//
+template<class Coordination>
+auto rate_limit(token_bucket bucket, Coordination cn) {
+    return [=](auto source) {
+        typedef typename std::decay_t<decltype(source)>::value_type value_type;
+        return Rx::create<value_type>(
+            [=](Rx::subscriber<value_type> out) {
+                auto now = token_bucket::clock_type::now();
+                auto due = bucket.reserve(now);
+                if (due <= now) {
+                    source.subscribe(out);
+                    return;
+                }
+                auto worker = cn.create_coordinator(out.get_subscription()).get_worker();
+                worker.schedule(due, Rx::make_schedulable(worker, [source, out](const Rx::schedulable&) {
+                    source.subscribe(out);
+                }));
+            });
+    };
+}
+
+inline auto rate_limit(token_bucket bucket) {
+    return rate_limit(std::move(bucket), identity_one_worker(make_thread_pool()));
+}
+
+template<class Coordination>
+auto rate_limit(double tokens_per_second, double burst, Coordination cn) {
+    return rate_limit(token_bucket(tokens_per_second, burst), std::move(cn));
+}
+
+inline auto rate_limit(double tokens_per_second, double burst) {
+    return rate_limit(token_bucket(tokens_per_second, burst));
+}
+
+namespace detail {
+
+template<class Result, class Progress>
+struct r_and_p 
+{
+    replay_one<Result> r;
+    Rx::maybe<Progress> p;
+    Rx::subject<Progress> psub;
+};
+
+template<class Result, class Progress, class Async>
+void complete_r_and_p(const std::shared_ptr<r_and_p<Result, Progress>>& state, Async const & completed) {
+    Rx::maybe<Result> result;
+    std::exception_ptr error;
+    try { result.reset(completed.GetResults()); }
+    catch (...) { error = std::current_exception(); }
+    state->r.complete(std::move(result), error);
+}
+
+template<class Result, class Progress>
+auto observe_r_and_p(const std::shared_ptr<r_and_p<Result, Progress>>& state) -> std::tuple<Rx::observable<Result>, Rx::observable<Progress>> {
+    auto result = Rx::create<Result>(
+        [=](Rx::subscriber<Result> out) {
+            std::weak_ptr<r_and_p<Result, Progress>> weak = state;
+            out.add([weak]() {
+                if (auto strong = weak.lock()) {
+                    strong->r.sweep();
+                }
+            });
+            state->r.add(out);
+        })
+        .as_dynamic();
+
+    auto progress = Rx::defer(
+        [=]() -> Rx::observable<Progress> {
+            auto result = state->psub
+                .get_observable();
+            if (!state->p.empty()) {
+                return result
+                    .start_with(state->p.get());
+            }
+            return result;
+        })
+        .as_dynamic();
+
+    return std::make_tuple(result, progress);
+}
+
+// single producer / single consumer slot that only keeps the latest value.
+// this is a triple buffer - the producer and consumer each own one slot and
+// trade it for the shared middle slot with one atomic exchange.
+template<class T>
+struct latest_value
+{
+    latest_value()
+        : back(0)
+        , middle(1)
+        , front(2)
+    {
+    }
+
+    void write(const T& t) {
+        slots[back] = t;
+        back = middle.exchange(back | dirty) & index;
+    }
+
+    bool read(T& t) {
+        if ((middle.load() & dirty) == 0) {
+            return false;
+        }
+        front = middle.exchange(front) & index;
+        t = slots[front];
+        return true;
+    }
+
+    // a write the consumer has not read yet
+    bool pending() const {
+        return (middle.load() & dirty) != 0;
+    }
+
+private:
+    static const int index = 3;
+    static const int dirty = 4;
+
+    T slots[3];
+    int back;
+    std::atomic<int> middle;
+    int front;
+};
+
+// WinRT serializes the Progress callbacks of an operation, so there is only
+// one producer. the worker may run schedulables concurrently (eg. a thread
+// pool), so one flush at a time is kept by the scheduled flag instead - only
+// the flush that holds it reads, and finish() takes it too, so completion
+// runs after the last flush and never beside it.
+template<class Progress>
+struct progress_conflation : public std::enable_shared_from_this<progress_conflation<Progress>>
+{
+    typedef Rx::scheduler::clock_type clock_type;
+
+    progress_conflation(clock_type::duration interval, Rx::worker worker)
+        : interval(interval)
+        , worker(std::move(worker))
+        , scheduled(false)
+        , finished(false)
+        , last(0)
+    {
+    }
+
+    template<class Emit>
+    void post(const Progress& progress, Emit emit) {
+        latest.write(progress);
+        if (scheduled.exchange(true)) {
+            return;
+        }
+        schedule_flush(emit);
+    }
+
+    template<class Emit, class Done>
+    void finish(Emit emit, Done d) {
+        done = std::move(d);
+        finished = true;
+        if (scheduled.exchange(true)) {
+            // the pending flush completes when it is done
+            return;
+        }
+        schedule_flush(emit);
+    }
+
+private:
+    template<class Emit>
+    void schedule_flush(Emit emit) {
+        auto that = this->shared_from_this();
+        auto flush = Rx::make_schedulable(worker, [that, emit](const Rx::schedulable&) {
+            that->flush(emit);
+        });
+        if (interval <= clock_type::duration::zero() || finished) {
+            // once per scheduler tick, and no wait for the last one
+            worker.schedule(flush);
+            return;
+        }
+        worker.schedule(clock_type::time_point(clock_type::duration(last.load())) + interval, flush);
+    }
+
+    template<class Emit>
+    void flush(Emit& emit) {
+        for (;;) {
+            Progress progress{};
+            if (latest.read(progress)) {
+                last = worker.now().time_since_epoch().count();
+                emit(progress);
+            }
+            // clear after the read so that no other flush reads beside this one
+            scheduled = false;
+            if (!finished && !latest.pending()) {
+                return;
+            }
+            // a value written before the clear, or finish() - unless a post
+            // or finish() took the flag back and scheduled a flush of its own
+            if (scheduled.exchange(true)) {
+                return;
+            }
+            if (!finished) {
+                schedule_flush(emit);
+                return;
+            }
+            if (!latest.pending()) {
+                // the flag stays taken - nothing flushes after this
+                done();
+                return;
+            }
+        }
+    }
+
+    const clock_type::duration interval;
+    Rx::worker worker;
+    latest_value<Progress> latest;
+    std::function<void()> done;
+    std::atomic<bool> scheduled;
+    std::atomic<bool> finished;
+    std::atomic<clock_type::rep> last;
+};
+
+}
+
+template<class Result, class Progress>
+auto from_async_with_progress(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop) -> std::tuple<Rx::observable<Result>, Rx::observable<Progress>> {
+    auto state = std::make_shared<detail::r_and_p<Result, Progress>>();
+
+    if (aop.Status() == AsyncStatus::Completed) {
+        detail::complete_r_and_p(state, aop);
+        state->psub.get_subscriber().on_completed();
+        return detail::observe_r_and_p(state);
+    }
+
+    aop.Progress([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const &, Progress const & progress) {
+        auto ps = state->psub.get_subscriber();
+        state->p.reset(progress);
+        ps.on_next(progress);
+    });
+
+    aop.Completed([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const & completed, AsyncStatus const &) {
+        detail::complete_r_and_p(state, completed);
+        state->psub.get_subscriber().on_completed();
+    });
+
+    return detail::observe_r_and_p(state);
+}
+
+// conflating progress - only the latest progress value is kept and it is
+// emitted on the coordination at most once per interval. a zero interval
+// emits at most once per scheduler tick.
+//
+//     Rx::from_async_with_progress(client.RetrieveFeedAsync(uri), chrono::milliseconds(100), Rx::identity_core_dispatcher());
+//
+template<class Result, class Progress, class Coordination>
+auto from_async_with_progress(const Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>& aop, Rx::scheduler::clock_type::duration interval, Coordination cn) -> std::tuple<Rx::observable<Result>, Rx::observable<Progress>> {
+    auto state = std::make_shared<detail::r_and_p<Result, Progress>>();
+
+    if (aop.Status() == AsyncStatus::Completed) {
+        // no progress left to conflate
+        detail::complete_r_and_p(state, aop);
+        state->psub.get_subscriber().on_completed();
+        return detail::observe_r_and_p(state);
+    }
+
+    auto conflation = std::make_shared<detail::progress_conflation<Progress>>(interval, cn.create_coordinator().get_worker());
+
+    auto emit = [state](Progress const & progress) {
+        auto ps = state->psub.get_subscriber();
+        state->p.reset(progress);
+        ps.on_next(progress);
+    };
+
+    aop.Progress([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const &, Progress const & progress) {
+        conflation->post(progress, emit);
+    });
+
+    aop.Completed([=](Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> const & completed, AsyncStatus const &) {
+        detail::complete_r_and_p(state, completed);
+        // flush the last progress and complete on the same worker as the progress
+        conflation->finish(emit, [state]() {
+            state->psub.get_subscriber().on_completed();
+        });
+    });
+
+    return detail::observe_r_and_p(state);
+}
+
+template<class Async, 
+    class AOP = std::result_of_t<Async()>, 
+    class Tuple = decltype(from_async_with_progress(AOP())), 
+    class Result = Rx::observable<std::decay_t<Tuple>>>
+auto start_async_with_progress(Async&& a) -> Result {
+    return Rx::create<Tuple>(
+        [=](Rx::subscriber<Tuple>& out) {
+            out.on_next(from_async_with_progress(a()));
+            out.on_completed();
+        });
+}
+
+template<class Async, class Coordination,
+    class AOP = std::result_of_t<Async()>,
+    class Tuple = decltype(from_async_with_progress(AOP())),
+    class Result = Rx::observable<std::decay_t<Tuple>>>
+auto start_async_with_progress(Async&& a, Rx::scheduler::clock_type::duration interval, Coordination cn) -> Result {
+    return Rx::create<Tuple>(
+        [=](Rx::subscriber<Tuple>& out) {
+            out.on_next(from_async_with_progress(a(), interval, cn));
+            out.on_completed();
+        });
+}
+
+// shared by an operator and whoever wants to watch it - eg. to size max_in_flight
+struct async_counters
+{
+    async_counters()
+        : in_flight(0)
+        , queued(0)
+        , completed(0)
+        , shed(0)
+    {
+    }
+
+    std::atomic<long> in_flight;
+    std::atomic<long> queued;
+    std::atomic<long> completed;
+    // dropped by shed_when
+    std::atomic<long> shed;
+};
+
+namespace detail {
+
+// the operator shared by merge_async, concat_eager and switch_latest_async.
+// State<T> is constructed from argn and the subscriber, and is fed the inner
+// observables with push, fail and finish. clear is called when the subscriber
+// unsubscribes.
+template<template<class> class State, class... ArgN>
+auto flatten_async(ArgN... argn) {
+    return [=](auto source) {
+        typedef typename std::decay_t<decltype(source)>::value_type inner_type;
+        typedef typename inner_type::value_type value_type;
+        return Rx::create<value_type>(
+            [=](Rx::subscriber<value_type> out) {
+                auto state = std::make_shared<State<value_type>>(argn..., out);
+
+                out.add([state]() {
+                    state->clear();
+                });
+
+                composite_subscription source_lifetime;
+                out.add(source_lifetime);
+
+                source.subscribe(
+                    source_lifetime,
+                    [state](const inner_type& inner) {
+                        state->push(inner.as_dynamic());
+                    },
+                    [state](std::exception_ptr e) {
+                        state->fail(e);
+                    },
+                    [state]() {
+                        state->finish();
+                    });
+            });
+    };
+}
+
+template<class T>
+struct merge_async_state : public std::enable_shared_from_this<merge_async_state<T>>
+{
+    merge_async_state(int max_in_flight, std::shared_ptr<async_counters> counters, Rx::subscriber<T> out)
+        : max_in_flight(max_in_flight)
+        , counters(std::move(counters))
+        , out(std::move(out))
+        , in_flight(0)
+        , draining(false)
+        , source_done(false)
+        , done(false)
+    {
+    }
+
+    void push(Rx::observable<T> inner) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            pending.push_back(std::move(inner));
+        }
+        ++counters->queued;
+        drain();
+    }
+
+    void finish() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            source_done = true;
+        }
+        drain();
+    }
+
+    void fail(std::exception_ptr e) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return;
+            }
+            done = true;
+        }
+        std::unique_lock<std::mutex> guard(emit_lock);
+        out.on_error(e);
+    }
+
+    void emit(const T& t) {
+        std::unique_lock<std::mutex> guard(emit_lock);
+        out.on_next(t);
+    }
+
+    void clear() {
+        long dropped = 0;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            dropped = static_cast<long>(pending.size());
+            pending.clear();
+        }
+        counters->queued -= dropped;
+    }
+
+    // only one thread at a time starts operations. a completion that arrives
+    // while another thread is draining is picked up by that thread's loop.
+    void drain() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (draining) {
+                return;
+            }
+            draining = true;
+        }
+        for (;;) {
+            Rx::observable<T> next;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (pending.empty() || in_flight >= max_in_flight) {
+                    draining = false;
+                    if (done || !source_done || !pending.empty() || in_flight != 0) {
+                        return;
+                    }
+                    done = true;
+                    guard.unlock();
+
+                    std::unique_lock<std::mutex> emit_guard(emit_lock);
+                    out.on_completed();
+                    return;
+                }
+                next = std::move(pending.front());
+                pending.pop_front();
+                ++in_flight;
+            }
+            --counters->queued;
+            ++counters->in_flight;
+            start(std::move(next));
+        }
+    }
+
+private:
+    void start(Rx::observable<T> inner) {
+        auto that = this->shared_from_this();
+
+        inner.subscribe(
+            inner_lifetime(out.get_subscription()),
+            [that](const T& t) {
+                that->emit(t);
+            },
+            [that](std::exception_ptr e) {
+                that->fail(e);
+            },
+            [that]() {
+                {
+                    std::unique_lock<std::mutex> guard(that->lock);
+                    --that->in_flight;
+                }
+                --that->counters->in_flight;
+                ++that->counters->completed;
+                that->drain();
+            });
+    }
+
+    const int max_in_flight;
+    std::shared_ptr<async_counters> counters;
+    Rx::subscriber<T> out;
+
+    std::mutex lock;
+    std::deque<Rx::observable<T>> pending;
+    int in_flight;
+    bool draining;
+    bool source_done;
+    bool done;
+
+    std::mutex emit_lock;
+};
+
+}
+
+// merges an observable of start_async() observables, keeping at most
+// max_in_flight of them subscribed. the next observable is only subscribed,
+// and so its factory only called, when one of the outstanding ones completes.
+//
+//     feeds.map([=](Uri uri) { return Rx::start_async([=]() { return client.RetrieveFeedAsync(uri); }); })
+//         | Rx::merge_async(4);
+//
+inline auto merge_async(int max_in_flight, std::shared_ptr<async_counters> counters = std::make_shared<async_counters>()) {
+    if (max_in_flight < 1) {
+        throw std::invalid_argument("merge_async requires max_in_flight > 0");
+    }
+    return detail::flatten_async<detail::merge_async_state>(max_in_flight, counters);
+}
+
+namespace detail {
+
+template<class T>
+struct concat_eager_state : public std::enable_shared_from_this<concat_eager_state<T>>
+{
+    struct slot
+    {
+        slot() : completed(false) {}
+        std::vector<T> values;
+        bool completed;
+    };
+
+    concat_eager_state(int max_in_flight, Rx::subscriber<T> out)
+        : out(std::move(out))
+        , ring(max_in_flight)
+        , head(0)
+        , next(0)
+        , draining(false)
+        , source_done(false)
+        , done(false)
+        , emitting(false)
+        , terminal(false)
+    {
+    }
+
+    void push(Rx::observable<T> inner) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            pending.push_back(std::move(inner));
+        }
+        drain();
+    }
+
+    void finish() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            source_done = true;
+        }
+        drain();
+    }
+
+    void fail(std::exception_ptr e) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (done) {
+            return;
+        }
+        done = true;
+        pending.clear();
+        error = e;
+        terminal = true;
+        emit(guard);
+    }
+
+    void clear() {
+        std::unique_lock<std::mutex> guard(lock);
+        pending.clear();
+    }
+
+    // same single-drainer loop as merge_async, but the window is measured
+    // from the oldest result that has not been emitted yet.
+    void drain() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (draining) {
+                return;
+            }
+            draining = true;
+        }
+        for (;;) {
+            Rx::observable<T> inner;
+            long long sequence = 0;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (pending.empty() || next - head >= static_cast<long long>(ring.size())) {
+                    draining = false;
+                    complete_if_idle();
+                    emit(guard);
+                    return;
+                }
+                inner = std::move(pending.front());
+                pending.pop_front();
+                sequence = next++;
+                at(sequence) = slot();
+            }
+            start(sequence, std::move(inner));
+        }
+    }
+
+private:
+    slot& at(long long sequence) {
+        return ring[static_cast<size_t>(sequence % static_cast<long long>(ring.size()))];
+    }
+
+    // called with lock held
+    void complete_if_idle() {
+        if (done || !source_done || !pending.empty() || head != next) {
+            return;
+        }
+        done = true;
+        terminal = true;
+    }
+
+    // called with lock held, which it releases around each call to out - an
+    // unsubscribe from downstream comes back in through clear(). one thread
+    // emits at a time and the others only queue in ready, so the order that
+    // was decided under the lock is kept.
+    void emit(std::unique_lock<std::mutex>& guard) {
+        if (emitting) {
+            return;
+        }
+        emitting = true;
+        for (;;) {
+            std::deque<T> values;
+            swap(values, ready);
+            if (values.empty()) {
+                // ready stays empty once done is set
+                if (terminal) {
+                    terminal = false;
+                    auto e = error;
+                    guard.unlock();
+                    if (e) {
+                        out.on_error(e);
+                    }
+                    else {
+                        out.on_completed();
+                    }
+                    guard.lock();
+                }
+                emitting = false;
+                return;
+            }
+            guard.unlock();
+            for (auto& t : values) {
+                out.on_next(t);
+            }
+            guard.lock();
+        }
+    }
+
+    void on_next(long long sequence, const T& t) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (done) {
+            return;
+        }
+        if (sequence == head) {
+            ready.push_back(t);
+            emit(guard);
+            return;
+        }
+        at(sequence).values.push_back(t);
+    }
+
+    void on_completed(long long sequence) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return;
+            }
+            at(sequence).completed = true;
+            // release every buffered result that is now at the head, in order
+            while (head != next && at(head).completed) {
+                at(head) = slot();
+                if (++head == next) {
+                    break;
+                }
+                auto& current = at(head);
+                for (auto& t : current.values) {
+                    ready.push_back(std::move(t));
+                }
+                current.values.clear();
+            }
+            emit(guard);
+        }
+        drain();
+    }
+
+    void start(long long sequence, Rx::observable<T> inner) {
+        auto that = this->shared_from_this();
+
+        inner.subscribe(
+            inner_lifetime(out.get_subscription()),
+            [that, sequence](const T& t) {
+                that->on_next(sequence, t);
+            },
+            [that](std::exception_ptr e) {
+                that->fail(e);
+            },
+            [that, sequence]() {
+                that->on_completed(sequence);
+            });
+    }
+
+    Rx::subscriber<T> out;
+
+    std::mutex lock;
+    std::deque<Rx::observable<T>> pending;
+    std::vector<slot> ring;
+    long long head;
+    long long next;
+    bool draining;
+    bool source_done;
+    bool done;
+
+    // values and the terminal notification waiting for emit()
+    std::deque<T> ready;
+    bool emitting;
+    bool terminal;
+    std::exception_ptr error;
+};
+
+}
+
+// concatenates an observable of start_async() observables while keeping up to
+// max_in_flight of them running. results are buffered in a reorder ring and
+// emitted strictly in the order the observables arrived.
+inline auto concat_eager(int max_in_flight) {
+    if (max_in_flight < 1) {
+        throw std::invalid_argument("concat_eager requires max_in_flight > 0");
+    }
+    return detail::flatten_async<detail::concat_eager_state>(max_in_flight);
+}
+
+//     feeds | Rx::concat_map_eager([=](Uri uri) { return Rx::start_async([=]() { return client.RetrieveFeedAsync(uri); }); }, 4);
+//
+template<class Selector>
+auto concat_map_eager(Selector selector, int max_in_flight) {
+    auto concat = concat_eager(max_in_flight);
+    return [=](auto source) {
+        return concat(source.map(selector));
+    };
+}
+
+namespace detail {
+
+template<class T>
+struct switch_async_state : public std::enable_shared_from_this<switch_async_state<T>>
+{
+    explicit switch_async_state(Rx::subscriber<T> out)
+        : out(std::move(out))
+        , generation(0)
+        , inner_active(false)
+        , source_done(false)
+        , done(false)
+    {
+    }
+
+    void push(Rx::observable<T> inner) {
+        composite_subscription previous;
+        composite_subscription next;
+        std::uint64_t id;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return;
+            }
+            previous = current;
+            current = next;
+            id = ++generation;
+            inner_active = true;
+        }
+        // cancel the superseded operation before the next one is started
+        previous.unsubscribe();
+        start(std::move(inner), next, id);
+    }
+
+    void finish() {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            source_done = true;
+            if (inner_active || done) {
+                return;
+            }
+            done = true;
+        }
+        std::unique_lock<std::mutex> guard(emit_lock);
+        out.on_completed();
+    }
+
+    void fail(std::exception_ptr e) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (done) {
+                return;
+            }
+            done = true;
+        }
+        std::unique_lock<std::mutex> guard(emit_lock);
+        out.on_error(e);
+    }
+
+    // out has already ended the current operation
+    void clear() {
+        std::unique_lock<std::mutex> guard(lock);
+        done = true;
+        current = composite_subscription();
+    }
+
+private:
+    bool is_current(std::uint64_t id) {
+        std::unique_lock<std::mutex> guard(lock);
+        return id == generation && !done;
+    }
+
+    void start(Rx::observable<T> inner, composite_subscription lifetime, std::uint64_t id) {
+        auto that = this->shared_from_this();
+
+        inner.subscribe(
+            inner_lifetime(out.get_subscription(), lifetime),
+            [that, id](const T& t) {
+                std::unique_lock<std::mutex> guard(that->emit_lock);
+                // a value from a superseded operation that was already on its way
+                if (that->is_current(id)) {
+                    that->out.on_next(t);
+                }
+            },
+            [that, id](std::exception_ptr e) {
+                if (that->is_current(id)) {
+                    that->fail(e);
+                }
+            },
+            [that, id]() {
+                {
+                    std::unique_lock<std::mutex> guard(that->lock);
+                    if (id != that->generation) {
+                        return;
+                    }
+                    that->inner_active = false;
+                    if (!that->source_done || that->done) {
+                        return;
+                    }
+                    that->done = true;
+                }
+                std::unique_lock<std::mutex> guard(that->emit_lock);
+                that->out.on_completed();
+            });
+    }
+
+    Rx::subscriber<T> out;
+    std::mutex emit_lock;
+
+    std::mutex lock;
+    composite_subscription current;
+    std::uint64_t generation;
+    bool inner_active;
+    bool source_done;
+    bool done;
+};
+
+}
+
+// mirrors only the newest operation. when the source emits, the previous
+// operation is unsubscribed - which cancels the WinRT operation - before the
+// new one is subscribed, so at most one operation per stream is in flight.
+inline auto switch_latest_async() {
+    return detail::flatten_async<detail::switch_async_state>();
+}
+
+//     query | Rx::switch_map_async([=](String text) { return Rx::start_async([=]() { return search.FindAsync(text); }); });
+//
+template<class Selector>
+auto switch_map_async(Selector selector) {
+    auto switch_latest = switch_latest_async();
+    return [=](auto source) {
+        return switch_latest(source.map(selector));
+    };
+}
+
+// drops inner operations before they are queued while the merge_async that
+// shares the counters has max_queued operations waiting. feed it the same
+// counters as merge_async so an outage cannot grow the queue without bound.
+//
+//     uris.map(start) | Rx::shed_when(counters, 256) | Rx::merge_async(8, counters)
+//
+inline auto shed_when(std::shared_ptr<async_counters> counters, long max_queued) {
+    return [=](auto source) {
+        typedef typename std::decay_t<decltype(source)>::value_type inner_type;
+        return source.filter([=](const inner_type&) {
+            if (counters->queued.load() < max_queued) {
+                return true;
+            }
+            ++counters->shed;
+            return false;
+        });
+    };
+}
+
+// the error from an open circuit - distinguishable by type, and fatal to
+// retry_backoff
+struct circuit_open : public Modern::Exception
+{
+    circuit_open()
+        : Modern::Exception(HRESULT_FROM_WIN32(ERROR_SERVICE_NOT_ACTIVE))
+    {
+    }
+};
+
+// cancellation and open circuits are not failures of the endpoint
+inline bool is_circuit_failure(std::exception_ptr ep) {
+    auto hr = hresult_of(ep);
+    return hr != HRESULT_FROM_WIN32(ERROR_CANCELLED) && hr != HRESULT_FROM_WIN32(ERROR_SERVICE_NOT_ACTIVE);
+}
+
+struct circuit_breaker_policy
+{
+    typedef std::chrono::steady_clock clock_type;
+
+    circuit_breaker_policy()
+        : failure_ratio(0.5)
+        , min_requests(10)
+        , window(std::chrono::seconds(10))
+        , open_duration(std::chrono::seconds(5))
+        , probes(1)
+        , failure(&is_circuit_failure)
+    {
+    }
+
+    // opens when at least min_requests finished inside the window and this
+    // share of them failed
+    double failure_ratio;
+    int min_requests;
+    clock_type::duration window;
+    // how long to fail fast before letting probes through
+    clock_type::duration open_duration;
+    // concurrent requests allowed while half-open
+    int probes;
+    std::function<bool(std::exception_ptr)> failure;
+};
+
+struct circuit_breaker_counters
+{
+    circuit_breaker_counters()
+        : rejected(0)
+        , opened(0)
+        , closed(0)
+    {
+    }
+
+    std::atomic<long> rejected;
+    std::atomic<long> opened;
+    std::atomic<long> closed;
+};
+
+enum class circuit_state
+{
+    closed,
+    open,
+    half_open
+};
+
+namespace detail {
+
+template<class Key, class Compare>
+struct circuit_breaker_state
+{
+    typedef circuit_breaker_policy::clock_type clock_type;
+
+    static const int buckets = 10;
+
+    struct bucket
+    {
+        bucket() : epoch(-1), successes(0), failures(0) {}
+
+        long long epoch;
+        int successes;
+        int failures;
+    };
+
+    struct circuit
+    {
+        circuit() : state(circuit_state::closed), probes(0) {}
+
+        circuit_state state;
+        bucket window[buckets];
+        clock_type::time_point open_until;
+        int probes;
+    };
+
+    explicit circuit_breaker_state(circuit_breaker_policy policy)
+        : policy(std::move(policy))
+        , span((std::max)(this->policy.window / buckets, clock_type::duration(1)))
+        , origin(clock_type::now())
+        , counters(std::make_shared<circuit_breaker_counters>())
+    {
+    }
+
+    // false when the request must fail fast. probe is set when the request
+    // is one of the half-open trial requests.
+    bool acquire(const Key& key, bool& probe) {
+        auto now = clock_type::now();
+        std::unique_lock<std::mutex> guard(lock);
+        auto& c = circuits[key];
+        probe = false;
+        if (c.state == circuit_state::open) {
+            if (now < c.open_until) {
+                ++counters->rejected;
+                return false;
+            }
+            c.state = circuit_state::half_open;
+            c.probes = 0;
+        }
+        if (c.state == circuit_state::half_open) {
+            if (c.probes >= policy.probes) {
+                ++counters->rejected;
+                return false;
+            }
+            ++c.probes;
+            probe = true;
+        }
+        return true;
+    }
+
+    void record(const Key& key, bool probe, bool failed) {
+        auto now = clock_type::now();
+        std::unique_lock<std::mutex> guard(lock);
+        auto& c = circuits[key];
+        if (c.state == circuit_state::half_open) {
+            if (!probe) {
+                return;
+            }
+            --c.probes;
+            if (failed) {
+                trip(c, now);
+                return;
+            }
+            c.state = circuit_state::closed;
+            for (auto& b : c.window) {
+                b = bucket();
+            }
+            ++counters->closed;
+            return;
+        }
+        if (c.state == circuit_state::open) {
+            return;
+        }
+
+        auto epoch = (now - origin) / span;
+        auto& b = c.window[epoch % buckets];
+        if (b.epoch != epoch) {
+            b = bucket();
+            b.epoch = epoch;
+        }
+        ++(failed ? b.failures : b.successes);
+        if (!failed) {
+            return;
+        }
+
+        long total = 0;
+        long failures = 0;
+        for (auto& w : c.window) {
+            if (w.epoch > epoch - buckets) {
+                total += w.successes + w.failures;
+                failures += w.failures;
+            }
+        }
+        if (total >= policy.min_requests && failures >= policy.failure_ratio * total) {
+            trip(c, now);
+        }
+    }
+
+    // a probe that was unsubscribed before it finished
+    void release(const Key& key) {
+        std::unique_lock<std::mutex> guard(lock);
+        auto& c = circuits[key];
+        if (c.state == circuit_state::half_open && c.probes > 0) {
+            --c.probes;
+        }
+    }
+
+    circuit_state state(const Key& key) {
+        std::unique_lock<std::mutex> guard(lock);
+        auto it = circuits.find(key);
+        if (it == circuits.end()) {
+            return circuit_state::closed;
+        }
+        if (it->second.state == circuit_state::open && it->second.open_until <= clock_type::now()) {
+            return circuit_state::half_open;
+        }
+        return it->second.state;
+    }
+
+    const circuit_breaker_policy policy;
+    const clock_type::duration span;
+    const clock_type::time_point origin;
+    std::shared_ptr<circuit_breaker_counters> counters;
+
+private:
+    void trip(circuit& c, clock_type::time_point now) {
+        c.state = circuit_state::open;
+        c.open_until = now + policy.open_duration;
+        c.probes = 0;
+        ++counters->opened;
+    }
+
+    std::mutex lock;
+    std::map<Key, circuit, Compare> circuits;
+};
+
+}
+
+// tracks failures per key - eg. per host - and fails requests fast with
+// circuit_open while that key's circuit is open. copies share the circuits.
+template<class Key, class Compare = std::less<Key>>
+class circuit_breaker
+{
+    typedef detail::circuit_breaker_state<Key, Compare> state_type;
+
+    std::shared_ptr<state_type> state;
+
+public:
+    typedef Key key_type;
+
+    explicit circuit_breaker(circuit_breaker_policy policy = circuit_breaker_policy())
+        : state(std::make_shared<state_type>(std::move(policy)))
+    {
+    }
+
+    std::shared_ptr<circuit_breaker_counters> counters() const {
+        return state->counters;
+    }
+
+    circuit_state state_of(const Key& key) const {
+        return state->state(key);
+    }
+
+    // the operator for one key. the source is not subscribed - so a
+    // start_async factory is not called - while the circuit is open.
+    auto guard(Key key) const {
+        auto that = state;
+        return [=](auto source) {
+            typedef typename std::decay_t<decltype(source)>::value_type value_type;
+            return Rx::create<value_type>(
+                [=](Rx::subscriber<value_type> out) {
+                    bool probe = false;
+                    if (!that->acquire(key, probe)) {
+                        out.on_error(std::make_exception_ptr(circuit_open()));
+                        return;
+                    }
+
+                    auto decided = std::make_shared<std::atomic<bool>>(false);
+                    out.add([=]() {
+                        if (probe && !decided->exchange(true)) {
+                            that->release(key);
+                        }
+                    });
+
+                    source.subscribe(
+                        out.get_subscription(),
+                        [out](const value_type& v) {
+                            out.on_next(v);
+                        },
+                        [=](std::exception_ptr e) {
+                            if (!decided->exchange(true)) {
+                                that->record(key, probe, that->policy.failure(e));
+                            }
+                            out.on_error(e);
+                        },
+                        [=]() {
+                            if (!decided->exchange(true)) {
+                                that->record(key, probe, false);
+                            }
+                            out.on_completed();
+                        });
+                });
+        };
+    }
+};
+
+//     Rx::circuit_breaker<std::wstring> hosts;
+//     Rx::start_async([=]() { return client.RetrieveFeedAsync(uri); })
+//         | Rx::with_circuit_breaker(hosts, uri.Host().Buffer())
+//         | Rx::retry_backoff();
+//
+// the key is not deduced, so anything that converts to the breaker's key type can be passed
+template<class Key, class Compare>
+auto with_circuit_breaker(const circuit_breaker<Key, Compare>& breaker, typename circuit_breaker<Key, Compare>::key_type key) {
+    return breaker.guard(std::move(key));
+}
+
+namespace detail {
+
+struct async_scope_state : public std::enable_shared_from_this<async_scope_state>
+{
+    struct node
+    {
+        explicit node(composite_subscription lifetime)
+            : lifetime(std::move(lifetime))
+            , prev(nullptr)
+            , next(nullptr)
+            , linked(false)
+        {
+        }
+
+        composite_subscription lifetime;
+        node* prev;
+        node* next;
+        bool linked;
+    };
+
+    async_scope_state()
+        : head(nullptr)
+        , count(0)
+        , closed(false)
+    {
+    }
+
+    // false once the scope has been torn down
+    bool add(composite_subscription lifetime) {
+        // owned by the unsubscribe callback - the list only links it
+        auto n = std::make_shared<node>(lifetime);
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (closed) {
+                return false;
+            }
+            n->next = head;
+            if (head) {
+                head->prev = n.get();
+            }
+            head = n.get();
+            n->linked = true;
+            ++count;
+        }
+        auto that = shared_from_this();
+        lifetime.add([that, n]() {
+            that->remove(n.get());
+        });
+        return true;
+    }
+
+    size_t outstanding() const {
+        std::unique_lock<std::mutex> guard(lock);
+        return count;
+    }
+
+    // unlinks one registration at a time, so an unsubscribe that ends other
+    // registrations in the scope cannot invalidate the walk
+    size_t cancel_all(bool close) {
+        size_t canceled = 0;
+        std::unique_lock<std::mutex> guard(lock);
+        closed = closed || close;
+        while (head) {
+            auto n = head;
+            unlink(n);
+            auto lifetime = n->lifetime;
+            guard.unlock();
+            lifetime.unsubscribe();
+            ++canceled;
+            guard.lock();
+        }
+        return canceled;
+    }
+
+private:
+    void remove(node* n) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (n->linked) {
+            unlink(n);
+        }
+    }
+
+    void unlink(node* n) {
+        if (n->prev) {
+            n->prev->next = n->next;
+        }
+        else {
+            head = n->next;
+        }
+        if (n->next) {
+            n->next->prev = n->prev;
+        }
+        n->prev = nullptr;
+        n->next = nullptr;
+        n->linked = false;
+        --count;
+    }
+
+    mutable std::mutex lock;
+    node* head;
+    size_t count;
+    bool closed;
+};
+
+}
+
+// the operations started by a page or view. every pipeline bound to the
+// scope is unsubscribed - canceling its WinRT operations - in one pass when
+// the scope is destroyed.
+//
+//     Rx::start_async([=]() { return client.RetrieveFeedAsync(uri); }) | Rx::in_scope(scope)
+//
+class async_scope
+{
+    typedef async_scope this_type;
+    async_scope(const this_type&);
+
+    std::shared_ptr<detail::async_scope_state> state;
+
+public:
+    async_scope()
+        : state(std::make_shared<detail::async_scope_state>())
+    {
+    }
+
+    ~async_scope()
+    {
+        state->cancel_all(true);
+    }
+
+    // the pipelines still in flight
+    size_t outstanding() const {
+        return state->outstanding();
+    }
+
+    // returns the number canceled. the scope stays open for new work.
+    size_t cancel_all() {
+        return state->cancel_all(false);
+    }
+
+    // subscriptions made after the scope is destroyed fail as canceled
+    auto bind() const {
+        auto that = state;
+        return [=](auto source) {
+            typedef typename std::decay_t<decltype(source)>::value_type value_type;
+            return Rx::create<value_type>(
+                [=](Rx::subscriber<value_type> out) {
+                    if (!that->add(out.get_subscription())) {
+                        out.on_error(detail::make_canceled_error());
+                        return;
+                    }
+                    source.subscribe(out);
+                });
+        };
+    }
+};
+
+inline auto in_scope(const async_scope& scope) {
+    return scope.bind();
+}
+
+struct async_cache_counters
+{
+    async_cache_counters()
+        : hits(0)
+        , misses(0)
+        , coalesced(0)
+        , evicted(0)
+    {
+    }
+
+    std::atomic<long> hits;
+    std::atomic<long> misses;
+    std::atomic<long> coalesced;
+    std::atomic<long> evicted;
+};
+
+namespace detail {
+
+template<class Key, class Result, class Compare>
+struct async_cache_state : public std::enable_shared_from_this<async_cache_state<Key, Result, Compare>>
+{
+    typedef std::chrono::steady_clock clock_type;
+    typedef Rx::subscriber<Result> subscriber_type;
+
+    struct entry
+    {
+        entry() : completed(false) {}
+
+        bool completed;
+        Rx::maybe<Result> result;
+        clock_type::time_point expires;
+        typename std::list<Key>::iterator recent;
+        std::vector<subscriber_type> waiting;
+        composite_subscription lifetime;
+    };
+    typedef std::map<Key, entry, Compare> entries_type;
+
+    explicit async_cache_state(size_t capacity)
+        : capacity(capacity)
+        , counters(std::make_shared<async_cache_counters>())
+    {
+    }
+
+    template<class Async>
+    void subscribe(const Key& key, const Async& factory, clock_type::duration ttl, subscriber_type out) {
+        std::unique_lock<std::mutex> guard(lock);
+
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.completed && it->second.expires <= clock_type::now()) {
+            erase(it);
+            it = entries.end();
+        }
+
+        if (it != entries.end() && it->second.completed) {
+            ++counters->hits;
+            recent.splice(recent.begin(), recent, it->second.recent);
+            auto result = it->second.result.get();
+            guard.unlock();
+
+            out.on_next(result);
+            out.on_completed();
+            return;
+        }
+
+        if (it != entries.end()) {
+            ++counters->coalesced;
+            it->second.waiting.push_back(out);
+            auto lifetime = it->second.lifetime;
+            guard.unlock();
+
+            watch(key, lifetime, out);
+            return;
+        }
+
+        ++counters->misses;
+        auto& created = entries[key];
+        created.waiting.push_back(out);
+        auto lifetime = created.lifetime;
+        guard.unlock();
+
+        watch(key, lifetime, out);
+
+        // the one operation shared by every subscriber to this key
+        auto that = this->shared_from_this();
+        try {
+            from_async(factory()).subscribe(
+                lifetime,
+                [that, key, lifetime, ttl](const Result& r) {
+                    that->complete(key, lifetime, r, ttl);
+                },
+                [that, key, lifetime](std::exception_ptr e) {
+                    that->fail(key, lifetime, e);
+                });
+        }
+        catch (...) {
+            fail(key, lifetime, std::current_exception());
+        }
+    }
+
+    const size_t capacity;
+    const std::shared_ptr<async_cache_counters> counters;
+
+private:
+    // called with lock held
+    void erase(typename entries_type::iterator it) {
+        if (it->second.completed) {
+            recent.erase(it->second.recent);
+        }
+        entries.erase(it);
+    }
+
+    void watch(const Key& key, composite_subscription lifetime, subscriber_type out) {
+        auto that = this->shared_from_this();
+        out.add([that, key, lifetime, out]() {
+            that->remove(key, lifetime, out);
+        });
+    }
+
+    // the last waiter leaving cancels the shared operation
+    void remove(const Key& key, composite_subscription lifetime, const subscriber_type& out) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto it = entries.find(key);
+            if (it == entries.end() || it->second.completed || !(it->second.lifetime == lifetime)) {
+                return;
+            }
+            auto& waiting = it->second.waiting;
+            waiting.erase(std::remove_if(waiting.begin(), waiting.end(),
+                [&](const subscriber_type& o) {
+                    return o.get_subscription() == out.get_subscription();
+                }),
+                waiting.end());
+            if (!waiting.empty()) {
+                return;
+            }
+            entries.erase(it);
+        }
+        lifetime.unsubscribe();
+    }
+
+    void complete(const Key& key, composite_subscription lifetime, const Result& r, clock_type::duration ttl) {
+        std::vector<subscriber_type> waiting;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto it = entries.find(key);
+            if (it == entries.end() || it->second.completed || !(it->second.lifetime == lifetime)) {
+                return;
+            }
+            swap(waiting, it->second.waiting);
+            if (ttl <= clock_type::duration::zero()) {
+                entries.erase(it);
+            }
+            else {
+                auto& completed = it->second;
+                completed.completed = true;
+                completed.result.reset(r);
+                completed.expires = clock_type::now() + ttl;
+                recent.push_front(key);
+                completed.recent = recent.begin();
+                while (recent.size() > capacity) {
+                    entries.erase(recent.back());
+                    recent.pop_back();
+                    ++counters->evicted;
+                }
+            }
+        }
+        for (auto& out : waiting) {
+            out.on_next(r);
+            out.on_completed();
+        }
+    }
+
+    void fail(const Key& key, composite_subscription lifetime, std::exception_ptr e) {
+        std::vector<subscriber_type> waiting;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            auto it = entries.find(key);
+            if (it == entries.end() || it->second.completed || !(it->second.lifetime == lifetime)) {
+                return;
+            }
+            // errors are not cached
+            swap(waiting, it->second.waiting);
+            entries.erase(it);
+        }
+        for (auto& out : waiting) {
+            out.on_error(e);
+        }
+    }
+
+    std::mutex lock;
+    entries_type entries;
+    // completed entries, most recently used first
+    std::list<Key> recent;
+};
+
+}
+
+// coalesces concurrent requests for the same key onto one WinRT operation and
+// keeps completed results for a time-to-live, evicting the least recently used
+// result once capacity is reached. errors and canceled operations are not kept.
+template<class Key, class Result, class Compare = std::less<Key>>
+class async_cache
+{
+    typedef detail::async_cache_state<Key, Result, Compare> state_type;
+
+    std::shared_ptr<state_type> state;
+
+public:
+    typedef Key key_type;
+    typedef typename state_type::clock_type clock_type;
+
+    explicit async_cache(size_t capacity = 64)
+        : state(std::make_shared<state_type>(capacity < 1 ? 1 : capacity))
+    {
+    }
+
+    std::shared_ptr<async_cache_counters> counters() const {
+        return state->counters;
+    }
+
+    template<class Async>
+    auto start_async(Key key, Async factory, typename clock_type::duration ttl) const -> Rx::observable<Result> {
+        auto that = state;
+        return Rx::create<Result>(
+            [=](Rx::subscriber<Result> out) {
+                that->subscribe(key, factory, ttl, out);
+            })
+            .as_dynamic();
+    }
+};
+
+//     Rx::async_cache<std::wstring, SyndicationFeed> feeds(32);
+//     Rx::start_async_cached(feeds, uri.AbsoluteUri().Buffer(), [=]() { return client.RetrieveFeedAsync(uri); }, chrono::minutes(5));
+//
+// the key is not deduced, so anything that converts to the cache's key type can be passed
+template<class Key, class Result, class Compare, class Async>
+auto start_async_cached(const async_cache<Key, Result, Compare>& cache, typename async_cache<Key, Result, Compare>::key_type key, Async factory, typename async_cache<Key, Result, Compare>::clock_type::duration ttl) -> Rx::observable<Result> {
+    return cache.start_async(std::move(key), std::move(factory), ttl);
+}
+
+namespace detail {
+
+const unsigned get_many_chunk = 64;
+
+// GetMany fills an array of projected items in place, the same way GetAt fills
+// one of them. that needs each item to be exactly its ABI type - bool, which
+// is projected through a BoolProxy, is not.
+template<class Item>
+struct is_get_many_layout
+    : std::integral_constant<bool, !std::is_same<Item, bool>::value && sizeof(std::remove_pointer_t<decltype(abi(std::declval<Item*>()))>) == sizeof(Item)>
+{
+};
+
+template<class Item>
+using IsGetManyLayout = typename std::enable_if<is_get_many_layout<Item>::value>::type *;
+
+template<class Item>
+using IsNotGetManyLayout = typename std::enable_if<!is_get_many_layout<Item>::value>::type *;
+
+// GetMany is only on the ABI of IVector and IVectorView - other random access
+// collections, eg. IObservableVector, are read through their IVector
+template<class Item>
+Windows::Foundation::Collections::IVectorView<Item> const & as_vector(Windows::Foundation::Collections::IVectorView<Item> const & items) {
+    return items;
+}
+
+template<class Item>
+Windows::Foundation::Collections::IVector<Item> const & as_vector(Windows::Foundation::Collections::IVector<Item> const & items) {
+    return items;
+}
+
+template<template<class> class Items, class Item>
+Windows::Foundation::Collections::IVector<Item> as_vector(Items<Item> const & items) {
+    return items;
+}
+
+template<class Items, class Item>
+unsigned get_many(Items const & items, unsigned start, Item* buffer, unsigned capacity) {
+    unsigned actual = 0;
+    check(as_vector(items)->abi_GetMany(start, capacity, abi(buffer), &actual));
+    return actual;
+}
+
+template<class Item>
+unsigned get_many(Windows::Foundation::Collections::IIterator<Item> const & iterator, Item* buffer, unsigned capacity) {
+    unsigned actual = 0;
+    check(iterator->abi_GetMany(capacity, abi(buffer), &actual));
+    return actual;
+}
+
+template<template<class> class Items, class Item, class Emit, IsRandomAccess<Items<Item>> = nullptr, IsGetManyLayout<Item> = nullptr>
+void for_each_chunk(Items<Item> const & items, unsigned chunk_size, Emit emit) {
+    for (unsigned start = 0;;) {
+        std::vector<Item> chunk(chunk_size);
+        auto actual = get_many(items, start, chunk.data(), chunk_size);
+        if (actual == 0) {
+            return;
+        }
+        chunk.resize(actual);
+        start += actual;
+        if (!emit(std::move(chunk)) || actual < chunk_size) {
+            return;
+        }
+    }
+}
+
+template<template<class> class Items, class Item, class Emit, IsNotRandomAccess<Items<Item>> = nullptr, IsGetManyLayout<Item> = nullptr>
+void for_each_chunk(Items<Item> const & items, unsigned chunk_size, Emit emit) {
+    auto iterator = items.First();
+    for (;;) {
+        std::vector<Item> chunk(chunk_size);
+        auto actual = get_many(iterator, chunk.data(), chunk_size);
+        if (actual == 0) {
+            return;
+        }
+        chunk.resize(actual);
+        if (!emit(std::move(chunk)) || actual < chunk_size) {
+            return;
+        }
+    }
+}
+
+// items that GetMany cannot fill in place are iterated one at a time
+template<template<class> class Items, class Item, class Emit, IsNotGetManyLayout<Item> = nullptr>
+void for_each_chunk(Items<Item> const & items, unsigned chunk_size, Emit emit) {
+    std::vector<Item> chunk;
+    for (Item const & item : items) {
+        chunk.push_back(item);
+        if (chunk.size() == chunk_size) {
+            if (!emit(std::move(chunk))) {
+                return;
+            }
+            chunk.clear();
+        }
+    }
+    if (!chunk.empty()) {
+        emit(std::move(chunk));
+    }
+}
+
+}
+
+// copies with Size() and GetMany into one pre-sized buffer instead of one
+// cross-ABI call per element.
+template<template<class> class Items, class Item, IsRandomAccess<Items<Item>> = nullptr, detail::IsGetManyLayout<Item> = nullptr>
+auto to_vector(Items<Item> items) {
+    std::vector<Item> copy(items.Size());
+    unsigned filled = 0;
+    while (filled < copy.size()) {
+        auto actual = detail::get_many(items, filled, copy.data() + filled, static_cast<unsigned>(copy.size()) - filled);
+        if (actual == 0) {
+            // the collection shrank
+            break;
+        }
+        filled += actual;
+    }
+    copy.resize(filled);
+    return copy;
+}
+
+template<template<class> class Items, class Item, IsNotRandomAccess<Items<Item>> = nullptr, detail::IsGetManyLayout<Item> = nullptr>
+auto to_vector(Items<Item> items) {
+    std::vector<Item> copy;
+    detail::for_each_chunk(items, detail::get_many_chunk, [&](std::vector<Item> chunk) {
+        if (copy.empty()) {
+            copy = std::move(chunk);
+        }
+        else {
+            std::move(chunk.begin(), chunk.end(), std::back_inserter(copy));
+        }
+        return true;
+    });
+    return copy;
+}
+
+template<template<class> class Items, class Item, detail::IsNotGetManyLayout<Item> = nullptr>
+auto to_vector(Items<Item> items) {
+    std::vector<Item> copy;
+    for (Item const & item : items) {
+        copy.push_back(item);
+    }
+    return copy;
+}
+
+// emits the collection in chunks of up to chunk_size items, fetched with
+// GetMany as they are emitted rather than after copying the whole collection.
+template<template<class> class Items, class Item>
+auto from_collection_chunked(Items<Item> items, unsigned chunk_size = detail::get_many_chunk) -> Rx::observable<std::vector<Item>> {
+    if (chunk_size < 1) {
+        throw std::invalid_argument("from_collection_chunked requires chunk_size > 0");
+    }
+    return Rx::create<std::vector<Item>>(
+        [=](Rx::subscriber<std::vector<Item>> out) {
+            detail::for_each_chunk(items, chunk_size, [&](std::vector<Item> chunk) {
+                out.on_next(std::move(chunk));
+                return out.is_subscribed();
+            });
+            out.on_completed();
+        })
+        .as_dynamic();
+}
+
+namespace detail {
+
+inline unsigned next_async_id() {
+    static std::atomic<unsigned> id(0);
+    return ++id;
+}
+
+template<class T, IsPod<T> = nullptr>
+T copy_out(T const & value) {
+    return value;
+}
+
+template<class T, IsNotPod<T> = nullptr>
+auto copy_out(T value) {
+    return detach(value);
+}
+
+// a WinRT async operation that is also the observer of the pipeline it
+// exposes. the status is a single atomic word so Status, ErrorCode and
+// GetResults never lock - only the handler slots are guarded.
+template<class Result, class Progress>
+struct async_operation
+    : Implements<Abi<Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>>, ABI::Windows::IAsyncInfo, ::IAgileObject>
+{
+    typedef Abi<Windows::Foundation::IAsyncOperationWithProgress<Result, Progress>> abi_type;
+    typedef Abi<Windows::Foundation::IAsyncOperationProgressHandler<Result, Progress>> progress_handler_type;
+    typedef Abi<Windows::Foundation::IAsyncOperationWithProgressCompletedHandler<Result, Progress>> completed_handler_type;
+
+    // the first four match AsyncStatus
+    enum state_type { started = 0, completed = 1, canceled = 2, error = 3, completing, closed };
+
+    async_operation()
+        : id(next_async_id())
+        , status(started)
+        , error_code(S_OK)
+        , completed_assigned(false)
+        , completed_invoked(false)
+    {
+    }
+
+    void start(Rx::observable<Result> result, Rx::observable<Progress> progress) {
+        ComPtr<async_operation> that;
+        that.CopyFrom(this);
+
+        // separate lifetimes - progress completing must not end the operation
+        composite_subscription pl;
+        lifetime.add(pl);
+        progress.subscribe(
+            pl,
+            [that](const Progress& p) {
+                that->report(p);
+            },
+            [](std::exception_ptr) {});
+
+        composite_subscription rl;
+        lifetime.add(rl);
+        result.subscribe(
+            rl,
+            [that](const Result& r) {
+                that->last.reset(r);
+            },
+            [that](std::exception_ptr e) {
+                if (that->claim()) {
+                    that->finish(error, hresult_of(e));
+                }
+            },
+            [that]() {
+                if (that->claim()) {
+                    if (that->last.empty()) {
+                        that->finish(error, HRESULT_FROM_WIN32(ERROR_NO_DATA));
+                    }
+                    else {
+                        that->finish(completed, S_OK);
+                    }
+                }
+            });
+    }
+
+    virtual HRESULT __stdcall put_Progress(progress_handler_type * handler) noexcept override {
+        std::unique_lock<std::mutex> guard(lock);
+        progress_handler.CopyFrom(handler);
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall get_Progress(progress_handler_type ** handler) noexcept override {
+        std::unique_lock<std::mutex> guard(lock);
+        progress_handler.CopyTo(handler);
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall put_Completed(completed_handler_type * handler) noexcept override {
+        ComPtr<completed_handler_type> ready;
+        int s;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (completed_assigned) {
+                return E_ILLEGAL_DELEGATE_ASSIGNMENT;
+            }
+            completed_assigned = true;
+            completed_handler.CopyFrom(handler);
+            s = status.load(std::memory_order_acquire);
+            if (!is_final(s) || !handler) {
+                return S_OK;
+            }
+            completed_invoked = true;
+            ready = completed_handler;
+        }
+        // already finished - WinRT calls a late handler immediately
+        ready->abi_Invoke(static_cast<abi_type*>(this), static_cast<AsyncStatus>(s));
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall get_Completed(completed_handler_type ** handler) noexcept override {
+        std::unique_lock<std::mutex> guard(lock);
+        completed_handler.CopyTo(handler);
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall abi_GetResults(AbiArgOut<Result> results) noexcept override {
+        switch (status.load(std::memory_order_acquire)) {
+        case completed:
+            return call([&] {
+                *results = copy_out(last.get());
+            });
+        case error:
+        case canceled:
+            return error_code;
+        default:
+            return E_ILLEGAL_METHOD_CALL;
+        }
+    }
+
+    virtual HRESULT __stdcall get_Id(unsigned * result) noexcept override {
+        *result = id;
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall get_Status(AsyncStatus * result) noexcept override {
+        auto s = status.load(std::memory_order_acquire);
+        if (s == closed) {
+            return E_ILLEGAL_METHOD_CALL;
+        }
+        *result = static_cast<AsyncStatus>(s == completing ? started : s);
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall get_ErrorCode(HRESULT * result) noexcept override {
+        auto s = status.load(std::memory_order_acquire);
+        if (s == closed) {
+            return E_ILLEGAL_METHOD_CALL;
+        }
+        *result = is_final(s) ? error_code : S_OK;
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall abi_Cancel() noexcept override {
+        if (claim()) {
+            finish(canceled, HRESULT_FROM_WIN32(ERROR_CANCELLED));
+        }
+        return S_OK;
+    }
+
+    virtual HRESULT __stdcall abi_Close() noexcept override {
+        auto s = status.load(std::memory_order_acquire);
+        while (s != closed) {
+            if (!is_final(s)) {
+                return E_ILLEGAL_STATE_CHANGE;
+            }
+            if (status.compare_exchange_weak(s, closed)) {
+                // releases the handlers and anything they captured
+                ComPtr<progress_handler_type> p;
+                ComPtr<completed_handler_type> c;
+                std::unique_lock<std::mutex> guard(lock);
+                swap(p, progress_handler);
+                swap(c, completed_handler);
+                guard.unlock();
+                break;
+            }
+        }
+        return S_OK;
+    }
+
+private:
+    static bool is_final(int s) {
+        return s == completed || s == canceled || s == error;
+    }
+
+    // only one of completion, error and Cancel wins
+    bool claim() {
+        int expected = started;
+        return status.compare_exchange_strong(expected, completing);
+    }
+
+    void finish(state_type s, HRESULT hr) {
+        error_code = hr;
+        status.store(s, std::memory_order_release);
+        lifetime.unsubscribe();
+
+        ComPtr<completed_handler_type> ready;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (!completed_handler || completed_invoked) {
+                return;
+            }
+            completed_invoked = true;
+            ready = completed_handler;
+        }
+        ready->abi_Invoke(static_cast<abi_type*>(this), static_cast<AsyncStatus>(s));
+    }
+
+    void report(const Progress& p) {
+        if (status.load(std::memory_order_acquire) != started) {
+            return;
+        }
+        ComPtr<progress_handler_type> handler;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            handler = progress_handler;
+        }
+        if (handler) {
+            handler->abi_Invoke(static_cast<abi_type*>(this), abi(p));
+        }
+    }
+
+    const unsigned id;
+    std::atomic<int> status;
+    HRESULT error_code;
+    Rx::maybe<Result> last;
+    composite_subscription lifetime;
+
+    std::mutex lock;
+    ComPtr<progress_handler_type> progress_handler;
+    ComPtr<completed_handler_type> completed_handler;
+    bool completed_assigned;
+    bool completed_invoked;
+};
+
+}
+
+// exposes observables as a WinRT async operation for components that return
+// Rx pipelines to WinRT callers. the last value of result is the result of the
+// operation, each value of progress is sent to the Progress handler and
+// Cancel() unsubscribes both.
+template<class Result, class Progress>
+auto to_async(Rx::observable<Result> result, Rx::observable<Progress> progress) -> Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> {
+    typedef detail::async_operation<Result, Progress> operation_type;
+    Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> aop;
+    auto op = new operation_type();
+    // aop owns the initial reference
+    *set(aop) = static_cast<typename operation_type::abi_type*>(op);
+    op->start(std::move(result), std::move(progress));
+    return aop;
+}
+
+template<class Result, class Progress>
+auto to_async(Rx::observable<Result> result) -> Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> {
+    return to_async<Result, Progress>(std::move(result), Rx::observable<>::never<Progress>());
+}
+
+// the inverse of from_async_with_progress
+template<class Result, class Progress>
+auto to_async(std::tuple<Rx::observable<Result>, Rx::observable<Progress>> rp) -> Windows::Foundation::IAsyncOperationWithProgress<Result, Progress> {
+    return to_async<Result, Progress>(std::get<0>(rp), std::get<1>(rp));
 }
 
 }
\ No newline at end of file
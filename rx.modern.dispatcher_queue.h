@@ -0,0 +1,260 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace Rx {
+
+    // what a dispatcher_queue drain has done with its time. all but queued
+    // are written only from the dispatcher thread.
+    struct dispatcher_budget_counters
+    {
+        dispatcher_budget_counters()
+            : frames(0)
+            , slices(0)
+            , items(0)
+            , overruns(0)
+            , worst_overrun_us(0)
+            , queued(0)
+            , total_queue_age_us(0)
+            , worst_queue_age_us(0)
+        {
+        }
+
+        // frames in which any work ran
+        std::atomic<long> frames;
+        // drain callbacks
+        std::atomic<long> slices;
+        std::atomic<long> items;
+        // slices that ran past the budget of their frame
+        std::atomic<long> overruns;
+        std::atomic<long long> worst_overrun_us;
+        // waiting to run now
+        std::atomic<long> queued;
+        // from schedule to run
+        std::atomic<long long> total_queue_age_us;
+        std::atomic<long long> worst_queue_age_us;
+    };
+
+    namespace detail {
+
+        // how much of a frame's budget the drains have spent. with a zero
+        // frame length every drain gets a whole budget of its own. takes the
+        // time as an argument so that it can be checked against a virtual clock.
+        class frame_budget
+        {
+        public:
+            typedef timer_wheel::clock_type clock_type;
+
+        private:
+            clock_type::duration budget;
+            clock_type::duration frame;
+            clock_type::time_point frame_start;
+            clock_type::duration spent;
+
+        public:
+            frame_budget(clock_type::duration budget, clock_type::duration frame)
+                : budget(budget)
+                , frame(frame)
+                , spent(clock_type::duration::zero())
+            {
+            }
+
+            // false when this frame's budget is already spent
+            bool begin(clock_type::time_point now, bool& new_frame) {
+                new_frame = frame <= clock_type::duration::zero() || frame_start == clock_type::time_point() || now >= frame_start + frame;
+                if (new_frame) {
+                    frame_start = now;
+                    spent = clock_type::duration::zero();
+                }
+                return spent < budget;
+            }
+
+            // when a slice that began at now must yield
+            clock_type::time_point deadline(clock_type::time_point now) const {
+                return now + (budget - spent);
+            }
+
+            // returns how far the frame has now run past its budget
+            clock_type::duration end(clock_type::time_point begun, clock_type::time_point now) {
+                spent += now - begun;
+                return spent > budget ? spent - budget : clock_type::duration::zero();
+            }
+
+            clock_type::time_point next_frame() const {
+                return frame_start + frame;
+            }
+
+            bool framed() const {
+                return frame > clock_type::duration::zero();
+            }
+        };
+
+        inline long long to_microseconds(timer_wheel::clock_type::duration d) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+        }
+    }
+
+    // the queue behind a batched dispatcher worker. schedules wait on an mpsc
+    // queue for the single drain callback that is in flight, instead of a
+    // post each. post hands the drain to the dispatcher - CoreDispatcher's
+    // RunAsync, or a stand-in. a drain runs items until its budget is spent,
+    // then yields by posting itself again or, with a frame length, by waiting
+    // on the wheel for the next frame.
+    class dispatcher_queue : public std::enable_shared_from_this<dispatcher_queue>
+    {
+    public:
+        typedef timer_wheel::clock_type clock_type;
+        typedef std::function<void(std::function<void()>)> post_type;
+
+    private:
+        typedef dispatcher_queue this_type;
+        dispatcher_queue(const this_type&);
+
+        struct queued_item
+        {
+            clock_type::time_point at;
+            // the deadline of a delayed item, empty for the rest
+            clock_type::time_point due;
+            schedulable scbl;
+        };
+
+        post_type post;
+        std::shared_ptr<timer_wheel> wheel;
+        std::shared_ptr<dispatcher_budget_counters> counters;
+        std::shared_ptr<detail::run_jitter> jitter;
+
+        detail::mpsc_queue<queued_item> queue;
+        std::atomic<bool> posted;
+        // only touched by the drain callback
+        std::deque<queued_item> pending;
+        detail::frame_budget budget;
+
+        void post_drain() {
+            auto that = shared_from_this();
+            post([that]() {
+                that->drain();
+            });
+        }
+
+        // the frame's budget is spent - wait for the next frame before
+        // posting again, so the rest of this frame belongs to input and
+        // rendering
+        void post_next_frame() {
+            auto that = shared_from_this();
+            wheel->insert(budget.next_frame(), [that]() {
+                that->post_drain();
+            });
+        }
+
+        void yield() {
+            if (budget.framed()) {
+                post_next_frame();
+            }
+            else {
+                post_drain();
+            }
+        }
+
+        void end_slice(clock_type::time_point begun) {
+            auto overrun = budget.end(begun, clock_type::now());
+            if (overrun > clock_type::duration::zero()) {
+                ++counters->overruns;
+                auto us = detail::to_microseconds(overrun);
+                if (us > counters->worst_overrun_us.load()) {
+                    counters->worst_overrun_us = us;
+                }
+            }
+        }
+
+        void drain() {
+            auto begun = clock_type::now();
+            bool new_frame = false;
+            if (!budget.begin(begun, new_frame)) {
+                post_next_frame();
+                return;
+            }
+            ++counters->slices;
+            bool ran = false;
+            auto deadline = budget.deadline(begun);
+            for (;;) {
+                queue.take_all(pending);
+                while (!pending.empty()) {
+                    auto item = std::move(pending.front());
+                    pending.pop_front();
+                    --counters->queued;
+
+                    auto start = clock_type::now();
+                    auto age = detail::to_microseconds(start - item.at);
+                    counters->total_queue_age_us += age;
+                    if (age > counters->worst_queue_age_us.load()) {
+                        counters->worst_queue_age_us = age;
+                    }
+                    if (item.due != clock_type::time_point()) {
+                        jitter->record(start, item.due);
+                    }
+                    if (new_frame && !ran) {
+                        ++counters->frames;
+                    }
+                    ran = true;
+
+                    if (item.scbl.is_subscribed()) {
+                        ++counters->items;
+                        try {
+                            // disallow recursion
+                            recursion r(false);
+                            item.scbl(r.get_recurse());
+                        }
+                        catch (...) {
+                            // keep the rest of the queue moving
+                            end_slice(begun);
+                            post_drain();
+                            throw;
+                        }
+                    }
+                    if (clock_type::now() >= deadline) {
+                        // out of budget - yield the dispatcher and come back
+                        end_slice(begun);
+                        yield();
+                        return;
+                    }
+                }
+                posted.store(false, std::memory_order_seq_cst);
+                // an item pushed before posted was cleared would be stranded
+                if (queue.empty() || posted.exchange(true, std::memory_order_seq_cst)) {
+                    end_slice(begun);
+                    return;
+                }
+            }
+        }
+
+    public:
+        // a zero frame gives every drain a whole budget of its own
+        dispatcher_queue(post_type post, std::shared_ptr<timer_wheel> wheel, clock_type::duration budget, clock_type::duration frame, std::shared_ptr<dispatcher_budget_counters> counters, std::shared_ptr<detail::run_jitter> jitter)
+            : post(std::move(post))
+            , wheel(std::move(wheel))
+            , counters(counters ? std::move(counters) : std::make_shared<dispatcher_budget_counters>())
+            , jitter(std::move(jitter))
+            , posted(false)
+            , budget(budget, frame)
+        {
+        }
+
+        std::shared_ptr<dispatcher_budget_counters> get_counters() const {
+            return counters;
+        }
+
+        // any thread. due is the deadline of a delayed item that came due,
+        // and empty for the rest
+        void schedule(clock_type::time_point due, const schedulable& scbl) {
+            ++counters->queued;
+            queue.push(queued_item{clock_type::now(), due, scbl});
+            if (!posted.exchange(true, std::memory_order_seq_cst)) {
+                post_drain();
+            }
+        }
+    };
+}
@@ -30,5 +30,8 @@ namespace Rx {
 }
 
 
-#include <rx.modern.async.h>
+#include <rx.modern.timer_wheel.h>
+#include <rx.modern.work_stealing.h>
+#include <rx.modern.dispatcher_queue.h>
 #include <rx.modern.schedulers.h>
+#include <rx.modern.async.h>
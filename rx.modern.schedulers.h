@@ -1,5 +1,11 @@
 #pragma once
 
+// added in the Windows 10 1803 SDK. the flag is rejected at run time before
+// 1803 and the timer falls back to an ordinary one.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
 namespace Rx {
 
     namespace wf = Windows::Foundation;
@@ -7,6 +13,186 @@ namespace Rx {
     namespace wuixaml = Windows::UI::Xaml;
     namespace wthread = Windows::System::Threading;
 
+    namespace detail {
+
+        inline wf::TimeSpan to_timespan(timer_wheel::clock_type::duration interval) {
+            typedef std::chrono::duration<int64_t, std::ratio<1, 10000000>> ticks;
+
+            // convert to 100ns ticks, rounding up so that a timer never fires early
+            auto t = std::chrono::duration_cast<ticks>(interval);
+            if (t < interval) {
+                ++t;
+            }
+
+            wf::TimeSpan timeSpan;
+            timeSpan.Duration = t.count();
+            return timeSpan;
+        }
+    }
+
+    // drives a timer_wheel with a single ThreadPoolTimer that is re-armed for
+    // the next time the wheel has work to do. with a granularity the timer is
+    // armed that much early and the remainder is spun out on the pool thread.
+    struct thread_pool_timer_driver
+    {
+    private:
+        typedef thread_pool_timer_driver this_type;
+        thread_pool_timer_driver(const this_type&);
+
+        std::weak_ptr<timer_wheel> wheel;
+        const timer_wheel::clock_type::duration granularity;
+        wthread::ThreadPoolTimer timer;
+
+    public:
+        explicit thread_pool_timer_driver(std::weak_ptr<timer_wheel> wheel, timer_wheel::clock_type::duration granularity = timer_wheel::clock_type::duration::zero())
+            : wheel(std::move(wheel))
+            , granularity(granularity)
+        {
+        }
+        ~thread_pool_timer_driver()
+        {
+            if (timer) {
+                timer.Cancel();
+            }
+        }
+
+        // called by the wheel with its lock held
+        void arm(timer_wheel::clock_type::time_point when) {
+            if (timer) {
+                timer.Cancel();
+                timer = nullptr;
+            }
+
+            auto interval = detail::early_arm(when, granularity) - timer_wheel::clock_type::now();
+            if (interval < timer_wheel::clock_type::duration::zero()) {
+                interval = timer_wheel::clock_type::duration::zero();
+            }
+
+            auto w = wheel;
+            auto g = granularity;
+            timer = wthread::ThreadPoolTimer::CreateTimer(
+                [w, g](wthread::ThreadPoolTimer) {
+                    if (auto strong = w.lock()) {
+                        detail::expire(*strong, strong->next_wake(), g);
+                    }
+                },
+                detail::to_timespan(interval));
+        }
+    };
+
+    inline std::shared_ptr<timer_wheel> make_thread_pool_timer_wheel(timer_wheel::clock_type::duration resolution = std::chrono::milliseconds(1), timer_wheel::clock_type::duration granularity = timer_wheel::clock_type::duration::zero()) {
+        return make_timer_wheel<thread_pool_timer_driver>(resolution, granularity);
+    }
+
+    // one wheel, and so one OS timer, for every deadline and delayed schedule
+    // in the process
+    inline std::shared_ptr<timer_wheel> shared_timer_wheel() {
+        static std::shared_ptr<timer_wheel> instance = make_thread_pool_timer_wheel();
+        return instance;
+    }
+
+    namespace detail {
+
+        struct waitable_timer_traits : Modern::HandleTraits<HANDLE>
+        {
+            static void Close(Type value) noexcept
+            {
+                MODERN_VERIFY(CloseHandle(value));
+            }
+        };
+
+        typedef Modern::Handle<waitable_timer_traits> waitable_timer_handle;
+
+        // sleeps on a high resolution waitable timer, which is not tied to
+        // the 15.6ms system tick. before Windows 10 1803 it is an ordinary
+        // one. an event wakes the wait when the deadline moves.
+        struct waitable_timer_wait
+        {
+            waitable_timer_wait()
+            {
+                attach(timer, CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS));
+                if (!timer) {
+                    attach(timer, CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS));
+                }
+                attach(event, CreateEventExW(nullptr, nullptr, 0, EVENT_ALL_ACCESS));
+                if (!timer || !event) {
+                    throw Modern::Exception(HRESULT_FROM_WIN32(GetLastError()));
+                }
+            }
+
+            void wait(std::unique_lock<std::mutex>& guard, timer_wheel::clock_type::time_point until) {
+                if (until == timer_wheel::clock_type::time_point::max()) {
+                    guard.unlock();
+                    WaitForSingleObjectEx(get(event), INFINITE, false);
+                    guard.lock();
+                    return;
+                }
+                // negative is relative, in 100ns ticks
+                LARGE_INTEGER relative;
+                relative.QuadPart = -detail::to_timespan(until - timer_wheel::clock_type::now()).Duration;
+                MODERN_VERIFY(SetWaitableTimerEx(get(timer), &relative, 0, nullptr, nullptr, nullptr, 0));
+                HANDLE handles[] = {get(timer), get(event)};
+                guard.unlock();
+                WaitForMultipleObjectsEx(2, handles, false, INFINITE, false);
+                guard.lock();
+            }
+
+            void wake() {
+                MODERN_VERIFY(SetEvent(get(event)));
+            }
+
+            waitable_timer_handle timer;
+            waitable_timer_handle event;
+        };
+    }
+
+    // drives a timer_wheel from one thread that waits on a high resolution
+    // timer armed spin early and spins out the rest, so the spin is bounded
+    // by spin however far away the deadline is.
+    typedef timer_thread_driver<detail::waitable_timer_wait> waitable_timer_driver;
+
+    inline std::shared_ptr<timer_wheel> make_waitable_timer_wheel(timer_wheel::clock_type::duration resolution = std::chrono::microseconds(100), timer_wheel::clock_type::duration spin = std::chrono::milliseconds(1)) {
+        return make_timer_wheel<waitable_timer_driver>(resolution, spin);
+    }
+
+    // a 100us wheel for sub-10ms deadlines that must not wait for the next
+    // system tick. it waits on a high resolution timer and spins at most the
+    // last 1ms on its own thread, so it is opt-in through
+    // timer_precision::precise.
+    inline std::shared_ptr<timer_wheel> shared_precise_timer_wheel() {
+        static std::shared_ptr<timer_wheel> instance = make_waitable_timer_wheel();
+        return instance;
+    }
+
+    enum class timer_precision
+    {
+        standard,
+        precise
+    };
+
+    inline std::shared_ptr<timer_wheel> timer_wheel_for(timer_precision precision) {
+        return precision == timer_precision::precise ? shared_precise_timer_wheel() : shared_timer_wheel();
+    }
+
+    namespace detail {
+
+        inline std::shared_ptr<run_jitter> run_jitter_for(timer_precision precision) {
+            static auto standard = std::make_shared<run_jitter>();
+            static auto precise = std::make_shared<run_jitter>();
+            return precision == timer_precision::precise ? precise : standard;
+        }
+    }
+
+    // how late the delayed items of a timer_precision started to run on the
+    // pool or the dispatcher
+    inline timer_jitter_report timer_jitter(timer_precision precision = timer_precision::standard) {
+        return detail::run_jitter_for(precision)->get();
+    }
+
+    inline void reset_timer_jitter(timer_precision precision = timer_precision::standard) {
+        detail::run_jitter_for(precision)->reset();
+    }
+
     struct core_dispatcher : public scheduler_interface
     {
     private:
@@ -19,75 +205,71 @@ namespace Rx {
             typedef core_dispatcher_worker this_type;
             core_dispatcher_worker(const this_type&);
 
-            wuicore::CoreDispatcher dispatcher;
-            wuicore::CoreDispatcherPriority priority;
+            std::shared_ptr<timer_wheel> wheel;
+            std::shared_ptr<dispatcher_queue> queue;
+
         public:
             virtual ~core_dispatcher_worker()
             {
             }
-            core_dispatcher_worker(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority)
-                : dispatcher(dispatcher)
-                , priority(priority)
+            core_dispatcher_worker(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority, timer_precision precision, clock_type::duration budget, clock_type::duration frame, std::shared_ptr<dispatcher_budget_counters> counters)
+                : wheel(timer_wheel_for(precision))
+                , queue(std::make_shared<dispatcher_queue>(
+                    [dispatcher, priority](std::function<void()> drain) {
+                        dispatcher.RunAsync(
+                            priority,
+                            [drain]() {
+                            drain();
+                        });
+                    },
+                    wheel, budget, frame, std::move(counters), detail::run_jitter_for(precision)))
             {
             }
 
+            std::shared_ptr<dispatcher_budget_counters> get_counters() const {
+                return queue->get_counters();
+            }
+
             virtual clock_type::time_point now() const {
                 return clock_type::now();
             }
 
             virtual void schedule(const schedulable& scbl) const {
-                dispatcher.RunAsync(
-                    priority, 
-                    [scbl]() {
-                    if (scbl.is_subscribed()) {
-                        // disallow recursion
-                        recursion r(false);
-                        scbl(r.get_recurse());
-                    }
-                });
+                queue->schedule(clock_type::time_point(), scbl);
             }
 
             virtual void schedule(clock_type::time_point when, const schedulable& scbl) const {
-                auto that = shared_from_this();
-
-                auto now = this->now();
-                auto interval = when - now;
-                if (now > when || interval < std::chrono::milliseconds(10))
+                if (when <= this->now())
                 {
                     schedule(scbl);
                     return;
                 }
 
-                wf::TimeSpan timeSpan;
-
-                // convert to 100ns ticks
-                timeSpan.Duration = static_cast<int32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count() / 100);
-
-                auto dispatcherTimer = wuixaml::DispatcherTimer();
-
-                dispatcherTimer.Interval(timeSpan);
-
-                auto token = dispatcherTimer.Tick(
-                    [dispatcherTimer, that, this, scbl](Windows::IInspectable, Windows::IInspectable) mutable {
-                        dispatcherTimer.Stop();
-                        schedule(scbl);
-                    });
-
-                scbl.add(
-                    [dispatcherTimer, token]() {
-                        dispatcherTimer.Tick(token);
-                    });
+                // the shared wheel holds the delay - one OS timer for every
+                // delayed item instead of a DispatcherTimer each. short delays
+                // are kept too, they are not rounded down to immediate.
+                auto queue = this->queue;
+                auto wheel = this->wheel;
+                auto timer = wheel->insert(when, [queue, when, scbl]() {
+                    queue->schedule(when, scbl);
+                });
 
-                // don't turn S_FALSE into exception
-                dispatcherTimer->abi_Start();
+                scbl.add([wheel, timer]() {
+                    wheel->cancel(timer);
+                });
             }
         };
 
         std::shared_ptr<core_dispatcher_worker> wi;
 
     public:
-        core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority)
-            : wi(std::make_shared<core_dispatcher_worker>(dispatcher, priority))
+        core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority, timer_precision precision = timer_precision::standard)
+            : wi(std::make_shared<core_dispatcher_worker>(dispatcher, priority, precision, std::chrono::milliseconds(4), clock_type::duration::zero(), nullptr))
+        {
+        }
+        // spends at most budget of each frame on queued work
+        core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority, clock_type::duration budget, clock_type::duration frame, std::shared_ptr<dispatcher_budget_counters> counters)
+            : wi(std::make_shared<core_dispatcher_worker>(dispatcher, priority, timer_precision::standard, budget, frame, std::move(counters)))
         {
         }
         virtual ~core_dispatcher()
@@ -101,43 +283,104 @@ namespace Rx {
         virtual worker create_worker(composite_subscription cs) const {
             return worker(std::move(cs), wi);
         }
+
+        std::shared_ptr<dispatcher_budget_counters> counters() const {
+            return wi->get_counters();
+        }
     };
 
-    inline scheduler make_core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
-        scheduler instance = make_scheduler<core_dispatcher>(dispatcher, priority);
+    inline scheduler make_core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal, timer_precision precision = timer_precision::standard) {
+        scheduler instance = make_scheduler<core_dispatcher>(dispatcher, priority, precision);
         return instance;
     }
 
-    inline scheduler make_core_dispatcher(wuixaml::Window window, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
+    inline scheduler make_core_dispatcher(wuixaml::Window window, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal, timer_precision precision = timer_precision::standard) {
         auto d = window.Dispatcher();
         if (d == nullptr)
         {
             throw std::logic_error("No dispatcher on current window");
         }
-        return make_core_dispatcher(d, priority);
+        return make_core_dispatcher(d, priority, precision);
     }
 
-    inline scheduler make_core_dispatcher(wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
+    inline scheduler make_core_dispatcher(wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal, timer_precision precision = timer_precision::standard) {
         auto window = wuixaml::Window::Current();
         if (window == nullptr)
         {
             throw std::logic_error("No window current");
         }
-        return make_core_dispatcher(window, priority);
+        return make_core_dispatcher(window, priority, precision);
     }
 
-    inline identity_one_worker identity_core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
-        identity_one_worker r(make_core_dispatcher(dispatcher, priority));
-        return r;
+    // time-slices background work on the UI thread - queued items run until
+    // budget_per_frame of the current frame is spent, then wait for the next
+    // frame. pass counters to watch overruns and queue age.
+    inline scheduler make_budgeted_core_dispatcher(
+        wuicore::CoreDispatcher dispatcher,
+        scheduler_interface::clock_type::duration budget_per_frame,
+        std::shared_ptr<dispatcher_budget_counters> counters = nullptr,
+        wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Idle,
+        scheduler_interface::clock_type::duration frame = std::chrono::microseconds(16667)) {
+        scheduler instance = make_scheduler<core_dispatcher>(dispatcher, priority, budget_per_frame, frame, std::move(counters));
+        return instance;
     }
-    inline identity_one_worker identity_core_dispatcher(wuixaml::Window window, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
-        identity_one_worker r(make_core_dispatcher(window, priority));
-        return r;
+
+    inline scheduler make_budgeted_core_dispatcher(
+        scheduler_interface::clock_type::duration budget_per_frame,
+        std::shared_ptr<dispatcher_budget_counters> counters = nullptr,
+        wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Idle,
+        scheduler_interface::clock_type::duration frame = std::chrono::microseconds(16667)) {
+        auto window = wuixaml::Window::Current();
+        if (window == nullptr)
+        {
+            throw std::logic_error("No window current");
+        }
+        auto d = window.Dispatcher();
+        if (d == nullptr)
+        {
+            throw std::logic_error("No dispatcher on current window");
+        }
+        return make_budgeted_core_dispatcher(d, budget_per_frame, std::move(counters), priority, frame);
     }
-    inline identity_one_worker identity_core_dispatcher(wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
-        identity_one_worker r(make_core_dispatcher(priority));
+
+    // an identity_one_worker that remembers its dispatcher, so that work
+    // which is already running on the dispatcher thread can skip the queue
+    class core_dispatcher_coordination : public identity_one_worker
+    {
+        wuicore::CoreDispatcher dispatcher;
+
+    public:
+        core_dispatcher_coordination(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority)
+            : identity_one_worker(make_core_dispatcher(dispatcher, priority))
+            , dispatcher(dispatcher)
+        {
+        }
+
+        bool has_thread_access() const {
+            return dispatcher.HasThreadAccess();
+        }
+    };
+
+    inline core_dispatcher_coordination identity_core_dispatcher(wuicore::CoreDispatcher dispatcher, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
+        core_dispatcher_coordination r(dispatcher, priority);
         return r;
     }
+    inline core_dispatcher_coordination identity_core_dispatcher(wuixaml::Window window, wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
+        auto d = window.Dispatcher();
+        if (d == nullptr)
+        {
+            throw std::logic_error("No dispatcher on current window");
+        }
+        return identity_core_dispatcher(d, priority);
+    }
+    inline core_dispatcher_coordination identity_core_dispatcher(wuicore::CoreDispatcherPriority priority = wuicore::CoreDispatcherPriority::Normal) {
+        auto window = wuixaml::Window::Current();
+        if (window == nullptr)
+        {
+            throw std::logic_error("No window current");
+        }
+        return identity_core_dispatcher(window, priority);
+    }
 
 
     struct thread_pool : public scheduler_interface
@@ -153,13 +396,29 @@ namespace Rx {
             thread_pool_worker(const this_type&);
 
             wthread::WorkItemPriority priority;
+            std::shared_ptr<timer_wheel> wheel;
+            std::shared_ptr<detail::run_jitter> jitter;
+
+            void run_due(clock_type::time_point due, const schedulable& scbl) const {
+                auto jitter = this->jitter;
+                wthread::ThreadPool::RunAsync([jitter, due, scbl](wf::IAsyncAction) {
+                    jitter->record(clock_type::now(), due);
+                    if (scbl.is_subscribed()) {
+                        // allow recursion
+                        recursion r(true);
+                        scbl(r.get_recurse());
+                    }
+                }, priority);
+            }
 
         public:
             virtual ~thread_pool_worker()
             {
             }
-            explicit thread_pool_worker(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal)
+            explicit thread_pool_worker(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal, timer_precision precision = timer_precision::standard)
                 : priority(priority)
+                , wheel(timer_wheel_for(precision))
+                , jitter(detail::run_jitter_for(precision))
             {
             }
 
@@ -178,30 +437,23 @@ namespace Rx {
             }
 
             virtual void schedule(clock_type::time_point when, const schedulable& scbl) const {
-                auto now = this->now();
-                auto interval = when - now;
-                if (now > when || interval < std::chrono::milliseconds(10))
+                if (when <= this->now())
                 {
-                    interval = std::chrono::milliseconds(1);
+                    schedule(scbl);
+                    return;
                 }
 
-                wf::TimeSpan timeSpan;
-
-                // convert to 100ns ticks
-                timeSpan.Duration = static_cast<int32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count() / 100);
-
-                auto timer = wthread::ThreadPoolTimer::CreateTimer(
-                    [scbl](wthread::ThreadPoolTimer) mutable {
-                        if (scbl.is_subscribed()) {
-                            // allow recursion
-                            recursion r(true);
-                            scbl(r.get_recurse());
-                        }
-                    },
-                    timeSpan);
+                // the shared wheel holds the delay - one ThreadPoolTimer for
+                // every delayed item. each expiry is handed to the pool so the
+                // wheel never runs work on its own thread.
+                auto that = std::static_pointer_cast<const thread_pool_worker>(shared_from_this());
+                auto wheel = this->wheel;
+                auto timer = wheel->insert(when, [that, when, scbl]() {
+                    that->run_due(when, scbl);
+                });
 
-                scbl.add([timer]() {
-                    timer.Cancel();
+                scbl.add([wheel, timer]() {
+                    wheel->cancel(timer);
                 });
             }
         };
@@ -209,8 +461,8 @@ namespace Rx {
         std::shared_ptr<thread_pool_worker> wi;
 
     public:
-        explicit thread_pool(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal)
-            : wi(std::make_shared<thread_pool_worker>(priority))
+        explicit thread_pool(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal, timer_precision precision = timer_precision::standard)
+            : wi(std::make_shared<thread_pool_worker>(priority, precision))
         {
         }
         virtual ~thread_pool()
@@ -226,12 +478,12 @@ namespace Rx {
         }
     };
 
-    inline scheduler make_thread_pool(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal) {
-        return make_scheduler<thread_pool>(priority);
+    inline scheduler make_thread_pool(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal, timer_precision precision = timer_precision::standard) {
+        return make_scheduler<thread_pool>(priority, precision);
     }
 
-    inline serialize_one_worker serialize_thread_pool(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal) {
-        serialize_one_worker r(make_thread_pool(priority));
+    inline serialize_one_worker serialize_thread_pool(wthread::WorkItemPriority priority = wthread::WorkItemPriority::Normal, timer_precision precision = timer_precision::standard) {
+        serialize_one_worker r(make_thread_pool(priority, precision));
         return r;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,540 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Rx {
+
+    namespace detail {
+
+        struct timer_node
+        {
+            timer_node()
+                : prev(nullptr)
+                , next(nullptr)
+                , tick(0)
+                , level(-1)
+                , slot(0)
+            {
+            }
+
+            timer_node* prev;
+            timer_node* next;
+            std::int64_t tick;
+            // the requested deadline - the tick is rounded up from it
+            std::chrono::steady_clock::time_point when;
+            // -1 when the node is not in the wheel
+            int level;
+            int slot;
+            std::function<void()> action;
+            // the wheel owns the node while it is linked
+            std::shared_ptr<timer_node> self;
+        };
+
+        // a coarse OS timer can fire up to one granularity late. to meet a
+        // deadline precisely it is armed one granularity early and the rest
+        // of the wait is spent in spin_until. both take the clock as an
+        // argument so that the timing can be checked against a virtual clock.
+        inline std::chrono::steady_clock::time_point early_arm(std::chrono::steady_clock::time_point when, std::chrono::steady_clock::duration granularity) {
+            if (granularity <= std::chrono::steady_clock::duration::zero() || when == std::chrono::steady_clock::time_point::max()) {
+                return when;
+            }
+            return when - granularity;
+        }
+
+        template<class Now>
+        std::chrono::steady_clock::time_point spin_until(std::chrono::steady_clock::time_point due, std::chrono::steady_clock::duration granularity, Now now) {
+            for (;;) {
+                auto t = now();
+                // only spin out the remainder of an early arm - never a long wait
+                if (t >= due || due - t > granularity) {
+                    return t;
+                }
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // how late timed actions ran, measured from the requested deadline. the
+    // wheel's own report stops at the time passed to advance()
+    struct timer_jitter_report
+    {
+        typedef std::chrono::steady_clock::duration duration;
+
+        static const int buckets = 8;
+
+        // upper bound of each histogram bucket - the last is unbounded
+        static duration bound(int bucket) {
+            static const std::chrono::microseconds bounds[buckets - 1] = {
+                std::chrono::microseconds(100), std::chrono::microseconds(500),
+                std::chrono::microseconds(1000), std::chrono::microseconds(2000),
+                std::chrono::microseconds(5000), std::chrono::microseconds(10000),
+                std::chrono::microseconds(20000)
+            };
+            return bucket < buckets - 1 ? duration(bounds[bucket]) : duration::max();
+        }
+
+        timer_jitter_report()
+            : fired(0)
+            , total(0)
+            , worst(0)
+        {
+            std::fill(std::begin(histogram), std::end(histogram), 0);
+        }
+
+        void record(duration late) {
+            if (late < duration::zero()) {
+                late = duration::zero();
+            }
+            ++fired;
+            total += late;
+            worst = (std::max)(worst, late);
+            int bucket = 0;
+            while (late > bound(bucket)) {
+                ++bucket;
+            }
+            ++histogram[bucket];
+        }
+
+        duration mean() const {
+            if (fired == 0) {
+                return duration::zero();
+            }
+            return total / static_cast<duration::rep>(fired);
+        }
+
+        long long fired;
+        duration total;
+        duration worst;
+        long long histogram[buckets];
+    };
+
+    // hierarchical timing wheel - one 256 slot wheel of single ticks and four
+    // 64 slot wheels of coarser ticks that cascade down as time advances.
+    // insert and cancel are O(1) and the wheel only ever needs one OS timer,
+    // armed through the arm function for the next time it has work to do.
+    //
+    // time only moves when advance() is called, so the wheel can be driven by
+    // any clock - a ThreadPoolTimer, a std::thread or a virtual clock.
+    class timer_wheel
+    {
+    public:
+        typedef std::chrono::steady_clock clock_type;
+        typedef std::shared_ptr<detail::timer_node> timer;
+        // called with the wheel lock held - must not call back into the wheel
+        typedef std::function<void(clock_type::time_point)> arm_type;
+
+    private:
+        typedef timer_wheel this_type;
+        timer_wheel(const this_type&);
+
+        static const int levels = 5;
+        static const int root_bits = 8;
+        static const int level_bits = 6;
+        static const int root_size = 1 << root_bits;
+        static const int level_size = 1 << level_bits;
+        static const std::int64_t max_delta = (std::int64_t(1) << (root_bits + (levels - 1) * level_bits)) - 1;
+
+        static int shift(int level) {
+            return level == 0 ? 0 : root_bits + (level - 1) * level_bits;
+        }
+        static int mask(int level) {
+            return level == 0 ? root_size - 1 : level_size - 1;
+        }
+        static int offset(int level) {
+            return level == 0 ? 0 : root_size + (level - 1) * level_size;
+        }
+
+        const clock_type::duration tick_length;
+        const clock_type::time_point origin;
+
+        mutable std::mutex lock;
+        arm_type arm;
+        clock_type::time_point armed;
+        // the next tick to be processed
+        std::int64_t current;
+        std::vector<detail::timer_node*> slots;
+        int counts[levels];
+        size_t total;
+        timer_jitter_report lateness;
+
+        std::int64_t tick_of(clock_type::time_point when) const {
+            if (when <= origin) {
+                return 0;
+            }
+            // round up - a timer never fires early
+            return ((when - origin) + tick_length - clock_type::duration(1)) / tick_length;
+        }
+
+        clock_type::time_point time_of(std::int64_t tick) const {
+            return origin + tick * tick_length;
+        }
+
+        void link(detail::timer_node* node) {
+            auto delta = node->tick - current;
+            if (delta < 0) {
+                delta = 0;
+            }
+            if (delta > max_delta) {
+                // beyond the outer wheel - park in its furthest slot and re-cascade from there
+                delta = max_delta;
+            }
+            auto placement = current + delta;
+
+            int level = 0;
+            while (level + 1 < levels && delta >= (std::int64_t(1) << shift(level + 1))) {
+                ++level;
+            }
+            node->level = level;
+            node->slot = static_cast<int>((placement >> shift(level)) & mask(level));
+
+            auto& head = slots[offset(level) + node->slot];
+            node->prev = nullptr;
+            node->next = head;
+            if (head) {
+                head->prev = node;
+            }
+            head = node;
+            ++counts[level];
+            ++total;
+        }
+
+        void unlink(detail::timer_node* node) {
+            auto& head = slots[offset(node->level) + node->slot];
+            if (node->prev) {
+                node->prev->next = node->next;
+            }
+            else {
+                head = node->next;
+            }
+            if (node->next) {
+                node->next->prev = node->prev;
+            }
+            --counts[node->level];
+            --total;
+            node->prev = nullptr;
+            node->next = nullptr;
+            node->level = -1;
+        }
+
+        void cascade(int level, int slot) {
+            auto node = slots[offset(level) + slot];
+            while (node) {
+                auto next = node->next;
+                unlink(node);
+                link(node);
+                node = next;
+            }
+        }
+
+        // the tick at which the node will either fire or move down a level
+        std::int64_t wake_tick(int level, int slot) const {
+            if (level == 0) {
+                return current + ((slot - current) & mask(0));
+            }
+            auto rotation = current >> shift(level);
+            auto distance = (slot - rotation) & mask(level);
+            if (distance == 0 && (current & ((std::int64_t(1) << shift(level)) - 1)) != 0) {
+                // this slot already cascaded in the current rotation
+                distance = level_size;
+            }
+            return (rotation + distance) << shift(level);
+        }
+
+        clock_type::time_point next_wake_locked() const {
+            if (total == 0) {
+                return clock_type::time_point::max();
+            }
+            auto best = std::numeric_limits<std::int64_t>::max();
+            for (int level = 0; level < levels; ++level) {
+                if (counts[level] == 0) {
+                    continue;
+                }
+                for (int slot = 0; slot <= mask(level); ++slot) {
+                    if (slots[offset(level) + slot]) {
+                        best = (std::min)(best, wake_tick(level, slot));
+                    }
+                }
+            }
+            return time_of(best);
+        }
+
+        void rearm(clock_type::time_point when) {
+            if (when >= armed) {
+                return;
+            }
+            armed = when;
+            if (arm) {
+                arm(when);
+            }
+        }
+
+    public:
+        explicit timer_wheel(clock_type::duration resolution = std::chrono::milliseconds(1), clock_type::time_point origin = clock_type::now())
+            : tick_length(resolution > clock_type::duration::zero() ? resolution : clock_type::duration(1))
+            , origin(origin)
+            , armed(clock_type::time_point::max())
+            , current(0)
+            , slots(root_size + (levels - 1) * level_size, nullptr)
+            , total(0)
+        {
+            std::fill(std::begin(counts), std::end(counts), 0);
+        }
+
+        ~timer_wheel()
+        {
+            for (auto node : slots) {
+                while (node) {
+                    auto next = node->next;
+                    node->level = -1;
+                    node->self.reset();
+                    node = next;
+                }
+            }
+        }
+
+        clock_type::duration resolution() const {
+            return tick_length;
+        }
+
+        size_t size() const {
+            std::unique_lock<std::mutex> guard(lock);
+            return total;
+        }
+
+        timer_jitter_report jitter() const {
+            std::unique_lock<std::mutex> guard(lock);
+            return lateness;
+        }
+
+        void reset_jitter() {
+            std::unique_lock<std::mutex> guard(lock);
+            lateness = timer_jitter_report();
+        }
+
+        clock_type::time_point next_wake() const {
+            std::unique_lock<std::mutex> guard(lock);
+            return next_wake_locked();
+        }
+
+        void set_arm(arm_type a) {
+            std::unique_lock<std::mutex> guard(lock);
+            arm = std::move(a);
+            armed = clock_type::time_point::max();
+            rearm(next_wake_locked());
+        }
+
+        timer insert(clock_type::time_point when, std::function<void()> action) {
+            auto node = std::make_shared<detail::timer_node>();
+            node->action = std::move(action);
+            node->when = when;
+
+            std::unique_lock<std::mutex> guard(lock);
+            node->tick = (std::max)(tick_of(when), current);
+            node->self = node;
+            link(node.get());
+            rearm(time_of(wake_tick(node->level, node->slot)));
+            return node;
+        }
+
+        // returns false when the timer has already fired or been canceled
+        bool cancel(const timer& t) {
+            std::function<void()> action;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (!t || t->level < 0) {
+                    return false;
+                }
+                unlink(t.get());
+                swap(action, t->action);
+                t->self.reset();
+            }
+            // the action is destroyed outside the lock
+            return true;
+        }
+
+        // runs every action that is due at or before now
+        void advance(clock_type::time_point now) {
+            std::vector<std::function<void()>> ready;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                auto target = now < origin ? std::int64_t(-1) : std::int64_t((now - origin) / tick_length);
+                while (current <= target) {
+                    if (total == 0) {
+                        current = target + 1;
+                        break;
+                    }
+                    auto index = static_cast<int>(current & mask(0));
+                    if (index == 0) {
+                        for (int level = 1; level < levels; ++level) {
+                            auto slot = static_cast<int>((current >> shift(level)) & mask(level));
+                            cascade(level, slot);
+                            if (slot != 0) {
+                                break;
+                            }
+                        }
+                    }
+                    auto node = slots[offset(0) + index];
+                    while (node) {
+                        auto next = node->next;
+                        unlink(node);
+                        lateness.record(now - node->when);
+                        ready.push_back(std::move(node->action));
+                        node->self.reset();
+                        node = next;
+                    }
+                    ++current;
+                    if (counts[0] == 0) {
+                        // nothing can fire before the next cascade
+                        current = (std::min)((current + mask(0)) & ~std::int64_t(mask(0)), target + 1);
+                    }
+                }
+                armed = clock_type::time_point::max();
+                rearm(next_wake_locked());
+            }
+            for (auto& action : ready) {
+                if (action) {
+                    action();
+                }
+            }
+        }
+    };
+
+    namespace detail {
+
+        // where every driver's wait ends - spin out the rest of an early
+        // wake-up, then run what is due
+        inline void expire(timer_wheel& wheel, timer_wheel::clock_type::time_point due, timer_wheel::clock_type::duration spin) {
+            auto now = spin_until(due, spin, []() {
+                return timer_wheel::clock_type::now();
+            });
+            wheel.advance(now);
+        }
+
+        // how late delayed items started to run, taken where they run - after
+        // the hop from the wheel onto the pool or the dispatcher
+        class run_jitter
+        {
+            mutable std::mutex lock;
+            timer_jitter_report report;
+
+        public:
+            void record(timer_wheel::clock_type::time_point now, timer_wheel::clock_type::time_point due) {
+                std::unique_lock<std::mutex> guard(lock);
+                report.record(now - due);
+            }
+
+            timer_jitter_report get() const {
+                std::unique_lock<std::mutex> guard(lock);
+                return report;
+            }
+
+            void reset() {
+                std::unique_lock<std::mutex> guard(lock);
+                report = timer_jitter_report();
+            }
+        };
+
+        // the wake-up state is shared with the thread, so the driver can be
+        // destroyed from inside the wheel's advance on that same thread
+        template<class Wait>
+        struct timer_thread_state
+        {
+            timer_thread_state()
+                : armed(timer_wheel::clock_type::time_point::max())
+                , stopping(false)
+            {
+            }
+
+            std::mutex lock;
+            timer_wheel::clock_type::time_point armed;
+            bool stopping;
+            Wait wait;
+        };
+    }
+
+    // drives a timer_wheel from one std::thread that sleeps until spin before
+    // the next time the wheel has work to do. Wait is all that differs between
+    // the drivers - wait(guard, until) sleeps with the lock released until
+    // the time or until wake() is called with the lock held. until is max
+    // when nothing is armed.
+    template<class Wait>
+    struct timer_thread_driver
+    {
+    private:
+        typedef timer_thread_driver this_type;
+        timer_thread_driver(const this_type&);
+
+        typedef detail::timer_thread_state<Wait> state_type;
+
+        std::shared_ptr<state_type> state;
+        std::thread thread;
+
+        static void run(std::shared_ptr<state_type> state, std::weak_ptr<timer_wheel> wheel, timer_wheel::clock_type::duration spin) {
+            std::unique_lock<std::mutex> guard(state->lock);
+            while (!state->stopping) {
+                auto due = state->armed;
+                auto early = detail::early_arm(due, spin);
+                if (due == timer_wheel::clock_type::time_point::max() || timer_wheel::clock_type::now() < early) {
+                    state->wait.wait(guard, early);
+                    continue;
+                }
+                state->armed = timer_wheel::clock_type::time_point::max();
+                guard.unlock();
+                // advance re-arms through arm(), which takes the lock
+                if (auto strong = wheel.lock()) {
+                    detail::expire(*strong, due, spin);
+                }
+                guard.lock();
+            }
+        }
+
+    public:
+        explicit timer_thread_driver(std::weak_ptr<timer_wheel> wheel, timer_wheel::clock_type::duration spin = timer_wheel::clock_type::duration::zero())
+            : state(std::make_shared<state_type>())
+            , thread(&timer_thread_driver::run, state, std::move(wheel), spin)
+        {
+        }
+        ~timer_thread_driver()
+        {
+            {
+                std::unique_lock<std::mutex> guard(state->lock);
+                state->stopping = true;
+                state->wait.wake();
+            }
+            if (thread.get_id() == std::this_thread::get_id()) {
+                thread.detach();
+            }
+            else {
+                thread.join();
+            }
+        }
+
+        // called by the wheel with its lock held
+        void arm(timer_wheel::clock_type::time_point when) {
+            std::unique_lock<std::mutex> guard(state->lock);
+            state->armed = when;
+            state->wait.wake();
+        }
+    };
+
+    // a wheel armed through a Driver constructed from the wheel and an. the
+    // wheel's arm function holds the driver.
+    template<class Driver, class... ArgN>
+    std::shared_ptr<timer_wheel> make_timer_wheel(timer_wheel::clock_type::duration resolution, ArgN&&... an) {
+        auto wheel = std::make_shared<timer_wheel>(resolution);
+        auto driver = std::make_shared<Driver>(wheel, std::forward<ArgN>(an)...);
+        wheel->set_arm([driver](timer_wheel::clock_type::time_point when) {
+            driver->arm(when);
+        });
+        return wheel;
+    }
+}
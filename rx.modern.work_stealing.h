@@ -0,0 +1,541 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace Rx {
+
+    namespace detail {
+
+        // Chase-Lev work-stealing deque, with the memory orderings from Le,
+        // Pop, Cohen and Zappa Nardelli. the owning thread pushes and pops at
+        // the bottom (LIFO), other threads steal from the top (FIFO).
+        template<class T>
+        class chase_lev_deque
+        {
+            typedef chase_lev_deque this_type;
+            chase_lev_deque(const this_type&);
+
+            struct ring
+            {
+                explicit ring(std::int64_t capacity)
+                    : capacity(capacity)
+                    , items(new std::atomic<T*>[static_cast<size_t>(capacity)])
+                {
+                }
+
+                T* get(std::int64_t i) const {
+                    return items[static_cast<size_t>(i & (capacity - 1))].load(std::memory_order_relaxed);
+                }
+
+                void put(std::int64_t i, T* item) {
+                    items[static_cast<size_t>(i & (capacity - 1))].store(item, std::memory_order_relaxed);
+                }
+
+                ring* grow(std::int64_t bottom, std::int64_t top) const {
+                    auto bigger = new ring(capacity * 2);
+                    for (auto i = top; i < bottom; ++i) {
+                        bigger->put(i, get(i));
+                    }
+                    return bigger;
+                }
+
+                const std::int64_t capacity;
+                std::unique_ptr<std::atomic<T*>[]> items;
+            };
+
+            std::atomic<std::int64_t> top;
+            std::atomic<std::int64_t> bottom;
+            std::atomic<ring*> array;
+            // a thief may still be reading an outgrown ring - they are only
+            // freed with the deque
+            std::vector<std::unique_ptr<ring>> retired;
+
+        public:
+            explicit chase_lev_deque(std::int64_t capacity = 256)
+                : top(0)
+                , bottom(0)
+                , array(new ring(capacity))
+            {
+            }
+
+            ~chase_lev_deque()
+            {
+                delete array.load();
+            }
+
+            // owner only
+            void push(T* item) {
+                auto b = bottom.load(std::memory_order_relaxed);
+                auto t = top.load(std::memory_order_acquire);
+                auto a = array.load(std::memory_order_relaxed);
+                if (b - t > a->capacity - 1) {
+                    auto bigger = a->grow(b, t);
+                    retired.emplace_back(a);
+                    array.store(bigger, std::memory_order_release);
+                    a = bigger;
+                }
+                a->put(b, item);
+                std::atomic_thread_fence(std::memory_order_release);
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+
+            // owner only
+            T* pop() {
+                auto b = bottom.load(std::memory_order_relaxed) - 1;
+                auto a = array.load(std::memory_order_relaxed);
+                bottom.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto t = top.load(std::memory_order_relaxed);
+                if (t > b) {
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                auto item = a->get(b);
+                if (t == b) {
+                    // the last item - race the thieves for it
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        item = nullptr;
+                    }
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+                return item;
+            }
+
+            // any thread. nullptr when empty or when another thief won the race
+            T* steal() {
+                auto t = top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                auto b = bottom.load(std::memory_order_acquire);
+                if (t >= b) {
+                    return nullptr;
+                }
+                auto a = array.load(std::memory_order_acquire);
+                auto item = a->get(t);
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return nullptr;
+                }
+                return item;
+            }
+
+            bool empty() const {
+                return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+            }
+        };
+
+        // multi-producer single-consumer queue. producers push onto a lock-free
+        // stack, the consumer takes the whole stack at once and reverses it, so
+        // a batch costs one atomic exchange however many items it holds.
+        template<class T>
+        class mpsc_queue
+        {
+            typedef mpsc_queue this_type;
+            mpsc_queue(const this_type&);
+
+            struct node
+            {
+                T value;
+                node* next;
+            };
+
+            std::atomic<node*> head;
+
+        public:
+            mpsc_queue()
+                : head(nullptr)
+            {
+            }
+            ~mpsc_queue()
+            {
+                auto n = head.load();
+                while (n) {
+                    auto next = n->next;
+                    delete n;
+                    n = next;
+                }
+            }
+
+            // any thread
+            void push(T value) {
+                auto n = new node{std::move(value), nullptr};
+                auto h = head.load(std::memory_order_relaxed);
+                do {
+                    n->next = h;
+                } while (!head.compare_exchange_weak(h, n, std::memory_order_release, std::memory_order_relaxed));
+            }
+
+            bool empty() const {
+                return head.load(std::memory_order_acquire) == nullptr;
+            }
+
+            // consumer only. appends everything pushed so far, oldest first
+            template<class Container>
+            void take_all(Container& out) {
+                auto n = head.exchange(nullptr, std::memory_order_acquire);
+                node* reversed = nullptr;
+                while (n) {
+                    auto next = n->next;
+                    n->next = reversed;
+                    reversed = n;
+                    n = next;
+                }
+                while (reversed) {
+                    auto next = reversed->next;
+                    out.push_back(std::move(reversed->value));
+                    delete reversed;
+                    reversed = next;
+                }
+            }
+        };
+
+        // std's own timed wait
+        struct condition_variable_wait
+        {
+            std::condition_variable cv;
+
+            void wait(std::unique_lock<std::mutex>& guard, timer_wheel::clock_type::time_point until) {
+                if (until == timer_wheel::clock_type::time_point::max()) {
+                    cv.wait(guard);
+                }
+                else {
+                    cv.wait_until(guard, until);
+                }
+            }
+
+            void wake() {
+                cv.notify_one();
+            }
+        };
+    }
+
+    // drives a timer_wheel with one std::thread that sleeps on a condition
+    // variable until the next time the wheel has work to do.
+    typedef timer_thread_driver<detail::condition_variable_wait> thread_timer_driver;
+
+    inline std::shared_ptr<timer_wheel> make_thread_timer_wheel(timer_wheel::clock_type::duration resolution = std::chrono::milliseconds(1)) {
+        return make_timer_wheel<thread_timer_driver>(resolution);
+    }
+
+    inline std::shared_ptr<timer_wheel> shared_thread_timer_wheel() {
+        static std::shared_ptr<timer_wheel> instance = make_thread_timer_wheel();
+        return instance;
+    }
+
+    namespace detail {
+
+        struct work_stealing_state : public std::enable_shared_from_this<work_stealing_state>
+        {
+            typedef chase_lev_deque<schedulable> deque_type;
+
+            explicit work_stealing_state(size_t count)
+                : discarded(false)
+                , pending(0)
+                , sleepers(0)
+                , waking(false)
+                , signals(0)
+                , stopping(false)
+            {
+                for (size_t i = 0; i < count; ++i) {
+                    deques.emplace_back(new deque_type());
+                }
+            }
+
+            ~work_stealing_state()
+            {
+                discard();
+            }
+
+            void start() {
+                auto that = shared_from_this();
+                for (size_t i = 0; i < deques.size(); ++i) {
+                    threads.emplace_back([that, i]() {
+                        that->run(i);
+                    });
+                }
+            }
+
+            void stop() {
+                {
+                    std::unique_lock<std::mutex> guard(park_lock);
+                    stopping = true;
+                    park.notify_all();
+                }
+                for (auto& t : threads) {
+                    // the last reference may be released by a task on the pool itself
+                    if (t.get_id() == std::this_thread::get_id()) {
+                        t.detach();
+                    }
+                    else {
+                        t.join();
+                    }
+                }
+                // queued items hold their worker and so this state - it would
+                // never be destroyed while they wait
+                discard();
+            }
+
+            void submit(const schedulable& scbl) {
+                auto item = new schedulable(scbl);
+                auto& self = current();
+                if (self.pool == this) {
+                    // recursive schedules stay on this thread, newest first
+                    deques[self.index]->push(item);
+                }
+                else {
+                    std::unique_lock<std::mutex> guard(inject_lock);
+                    if (discarded) {
+                        // a delayed item that came due after stop
+                        guard.unlock();
+                        delete item;
+                        return;
+                    }
+                    injected.push_back(item);
+                }
+                // pairs with the check in run() after a thread counts itself
+                // asleep - either it sees this item or this sees the sleeper
+                ++pending;
+                wake_one();
+            }
+
+        private:
+            struct thread_identity
+            {
+                const work_stealing_state* pool;
+                size_t index;
+            };
+
+            static thread_identity& current() {
+                static thread_local thread_identity identity = {nullptr, 0};
+                return identity;
+            }
+
+            // one wake-up in flight at a time. the woken thread passes it on
+            // when it finds more work, so a burst wakes the pool one thread
+            // after another instead of taking park_lock on every push.
+            void wake_one() {
+                if (sleepers.load() == 0 || waking.exchange(true)) {
+                    return;
+                }
+                std::unique_lock<std::mutex> guard(park_lock);
+                ++signals;
+                park.notify_one();
+            }
+
+            void run(size_t index) {
+                current().pool = this;
+                current().index = index;
+                std::minstd_rand random(static_cast<std::minstd_rand::result_type>(index + 1));
+
+                for (;;) {
+                    auto item = take(index, random);
+                    if (item) {
+                        if (pending.load() > 0) {
+                            wake_one();
+                        }
+                        execute(item);
+                        continue;
+                    }
+                    std::unique_lock<std::mutex> guard(park_lock);
+                    ++sleepers;
+                    if (pending.load() > 0 && !stopping) {
+                        // pushed before this thread counted itself asleep
+                        --sleepers;
+                        continue;
+                    }
+                    // parks until a wake-up is handed to it - not while there
+                    // is pending work, which another thread may be taking
+                    park.wait(guard, [this]() {
+                        return stopping || signals > 0;
+                    });
+                    --sleepers;
+                    if (stopping) {
+                        return;
+                    }
+                    --signals;
+                    waking = false;
+                }
+            }
+
+            schedulable* take(size_t index, std::minstd_rand& random) {
+                auto item = find(index, random);
+                if (item) {
+                    --pending;
+                }
+                return item;
+            }
+
+            schedulable* find(size_t index, std::minstd_rand& random) {
+                if (auto item = deques[index]->pop()) {
+                    return item;
+                }
+                {
+                    std::unique_lock<std::mutex> guard(inject_lock);
+                    if (!injected.empty()) {
+                        auto item = injected.front();
+                        injected.pop_front();
+                        return item;
+                    }
+                }
+                auto count = deques.size();
+                auto first = static_cast<size_t>(random()) % count;
+                for (size_t i = 0; i < count; ++i) {
+                    auto victim = (first + i) % count;
+                    if (victim == index) {
+                        continue;
+                    }
+                    if (auto item = deques[victim]->steal()) {
+                        return item;
+                    }
+                }
+                return nullptr;
+            }
+
+            // only once the threads have stopped - the deques have no owner
+            void discard() {
+                std::vector<std::unique_ptr<schedulable>> items;
+                for (auto& d : deques) {
+                    while (auto item = d->pop()) {
+                        items.emplace_back(item);
+                    }
+                }
+                std::unique_lock<std::mutex> guard(inject_lock);
+                discarded = true;
+                for (auto item : injected) {
+                    items.emplace_back(item);
+                }
+                injected.clear();
+                guard.unlock();
+                // released outside the lock - they may release the last
+                // reference to a worker
+            }
+
+            void execute(schedulable* item) {
+                std::unique_ptr<schedulable> scbl(item);
+                if (scbl->is_subscribed()) {
+                    // allow recursion
+                    recursion r(true);
+                    (*scbl)(r.get_recurse());
+                }
+            }
+
+            std::vector<std::unique_ptr<deque_type>> deques;
+            std::vector<std::thread> threads;
+
+            std::mutex inject_lock;
+            std::deque<schedulable*> injected;
+            bool discarded;
+
+            // pushed and not yet taken
+            std::atomic<long> pending;
+            std::atomic<int> sleepers;
+            std::atomic<bool> waking;
+            std::mutex park_lock;
+            std::condition_variable park;
+            // wake-ups handed out and not yet taken by a parked thread
+            int signals;
+            bool stopping;
+        };
+    }
+
+    // a portable thread pool - one Chase-Lev deque per thread, LIFO for work
+    // scheduled from inside the pool and FIFO steals between threads. work
+    // scheduled from outside the pool goes through one shared queue, and
+    // delayed work waits on the shared thread timer wheel.
+    struct work_stealing_pool : public scheduler_interface
+    {
+    private:
+        typedef work_stealing_pool this_type;
+        work_stealing_pool(const this_type&);
+
+        struct work_stealing_worker : public worker_interface
+        {
+        private:
+            typedef work_stealing_worker this_type;
+            work_stealing_worker(const this_type&);
+
+            std::shared_ptr<detail::work_stealing_state> state;
+
+        public:
+            virtual ~work_stealing_worker()
+            {
+            }
+            explicit work_stealing_worker(std::shared_ptr<detail::work_stealing_state> state)
+                : state(std::move(state))
+            {
+            }
+
+            virtual clock_type::time_point now() const {
+                return clock_type::now();
+            }
+
+            virtual void schedule(const schedulable& scbl) const {
+                state->submit(scbl);
+            }
+
+            virtual void schedule(clock_type::time_point when, const schedulable& scbl) const {
+                if (when <= now()) {
+                    schedule(scbl);
+                    return;
+                }
+
+                auto that = state;
+                auto wheel = shared_thread_timer_wheel();
+                auto timer = wheel->insert(when, [that, scbl]() {
+                    that->submit(scbl);
+                });
+
+                scbl.add([wheel, timer]() {
+                    wheel->cancel(timer);
+                });
+            }
+        };
+
+        std::shared_ptr<detail::work_stealing_state> state;
+        std::shared_ptr<work_stealing_worker> wi;
+
+    public:
+        explicit work_stealing_pool(size_t threads)
+            : state(std::make_shared<detail::work_stealing_state>(threads < 1 ? 1 : threads))
+            , wi(std::make_shared<work_stealing_worker>(state))
+        {
+            state->start();
+        }
+        virtual ~work_stealing_pool()
+        {
+            state->stop();
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual worker create_worker(composite_subscription cs) const {
+            return worker(std::move(cs), wi);
+        }
+    };
+
+    // a dedicated pool with its own threads
+    inline scheduler make_work_stealing_pool(size_t threads) {
+        return make_scheduler<work_stealing_pool>(threads);
+    }
+
+    // the process-wide pool, one thread per core - cheap to call repeatedly,
+    // like make_thread_pool
+    inline scheduler make_work_stealing_pool() {
+        static scheduler instance = make_work_stealing_pool(std::thread::hardware_concurrency());
+        return instance;
+    }
+
+    inline serialize_one_worker serialize_work_stealing_pool() {
+        serialize_one_worker r(make_work_stealing_pool());
+        return r;
+    }
+}
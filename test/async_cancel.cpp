@@ -0,0 +1,115 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+#include "fake_async.h"
+
+// from_async shares one Completed handler between its subscribers. the
+// operation is canceled when the last of them unsubscribes and is closed -
+// releasing the handler - once it has finished, however it finished.
+
+static void cancel_on_last_unsubscribe() {
+    auto op = fake::make_async<int>();
+    auto source = Rx::from_async(op.aop);
+
+    int first = 0, second = 0;
+    auto a = source.subscribe([&](int v) { first = v; });
+    auto b = source.subscribe([&](int v) { second = v; });
+    CHECK(op.state->has_handler());
+
+    a.unsubscribe();
+    CHECK(op.state->counters->cancels == 0);
+    CHECK(op.state->counters->closes == 0);
+
+    b.unsubscribe();
+    CHECK(op.state->counters->cancels == 1);
+    CHECK(op.state->counters->closes == 1);
+    CHECK(!op.state->has_handler());
+
+    // a result after the cancel is not delivered
+    op.state->complete(42);
+    CHECK(first == 0);
+    CHECK(second == 0);
+}
+
+static void canceled_is_an_error() {
+    auto op = fake::make_async<int>();
+
+    HRESULT error = S_OK;
+    bool completed = false;
+    auto a = Rx::from_async(op.aop).subscribe(
+        [](int) {},
+        [&](std::exception_ptr ep) {
+            try { std::rethrow_exception(ep); }
+            catch (const Modern::Exception& ex) { error = ex.Result; }
+        },
+        [&]() { completed = true; });
+
+    // canceled by someone other than the subscriber
+    op.aop.Cancel();
+    CHECK(error == HRESULT_FROM_WIN32(ERROR_CANCELLED));
+    CHECK(!completed);
+    CHECK(op.state->counters->closes == 1);
+}
+
+static void completed_is_not_canceled() {
+    auto op = fake::make_async<int>();
+    auto source = Rx::from_async(op.aop);
+
+    int first = 0, late = 0;
+    auto a = source.subscribe([&](int v) { first = v; });
+    op.state->complete(7);
+    CHECK(first == 7);
+    CHECK(op.state->counters->closes == 1);
+    CHECK(!op.state->has_handler());
+
+    // a late subscriber gets the result that was kept
+    auto b = source.subscribe([&](int v) { late = v; });
+    CHECK(late == 7);
+
+    a.unsubscribe();
+    b.unsubscribe();
+    CHECK(op.state->counters->cancels == 0);
+    CHECK(op.state->counters->closes == 1);
+}
+
+static void finished_before_subscribe() {
+    auto op = fake::make_async<int>();
+    op.state->complete(3);
+
+    int value = 0;
+    bool completed = false;
+    Rx::from_async(op.aop).subscribe([&](int v) { value = v; }, [](std::exception_ptr) {}, [&]() { completed = true; });
+    CHECK(value == 3);
+    CHECK(completed);
+    // completed inline - the handler was never registered
+    CHECK(!op.state->has_handler());
+    CHECK(op.state->counters->cancels == 0);
+}
+
+static void resubscribe_after_cancel() {
+    auto op = fake::make_async<int>();
+    auto source = Rx::from_async(op.aop);
+
+    source.subscribe([](int) {}).unsubscribe();
+    CHECK(op.state->counters->cancels == 1);
+
+    HRESULT error = S_OK;
+    source.subscribe(
+        [](int) {},
+        [&](std::exception_ptr ep) {
+            try { std::rethrow_exception(ep); }
+            catch (const Modern::Exception& ex) { error = ex.Result; }
+        });
+    CHECK(error == HRESULT_FROM_WIN32(ERROR_CANCELLED));
+    CHECK(op.state->counters->cancels == 1);
+}
+
+int main() {
+    cancel_on_last_unsubscribe();
+    canceled_is_an_error();
+    completed_is_not_canceled();
+    finished_before_subscribe();
+    resubscribe_after_cancel();
+    return check_result();
+}
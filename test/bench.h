@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// the benchmarks are plain programs that print one line per measurement.
+// the repeat count can be scaled down from the command line so that ctest
+// runs them quickly:
+//
+//     bench_work_stealing 0.01
+//
+inline double bench_scale(int argc, char** argv) {
+    return argc > 1 ? std::atof(argv[1]) : 1.0;
+}
+
+inline long bench_count(long count, double scale) {
+    auto scaled = static_cast<long>(count * scale);
+    return scaled < 1 ? 1 : scaled;
+}
+
+template<class F>
+double bench_seconds(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline void bench_report(const std::string& name, long items, double seconds) {
+    std::printf("%-48s %10ld items %10.1f ns/item %10.2f M items/s\n",
+        name.c_str(), items, seconds * 1e9 / items, items / seconds / 1e6);
+}
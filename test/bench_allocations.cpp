@@ -0,0 +1,104 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "bench.h"
+#include "fake_async.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace Modern;
+
+// heap allocations per from_async against the implementation it replaced -
+// Rx::create(...).as_dynamic().publish().ref_count() around the Completed
+// handler. each op is observe, subscribe, complete. creating the operation
+// itself is not counted.
+
+static std::atomic<long> allocations(0);
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (auto p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace previous {
+
+    template<class Result, class Async>
+    auto from_async(const Async& aop) -> Rx::observable<Result> {
+        return Rx::create<Result>(
+            [=](Rx::subscriber<Result>& out) {
+                aop.Completed([=](Async const & completed, AsyncStatus const & status) {
+                    if (status == AsyncStatus::Canceled) {
+                        out.on_error(Rx::detail::make_canceled_error());
+                    }
+                    else {
+                        try { out.on_next(completed.GetResults()); }
+                        catch (...) { out.on_error(std::current_exception()); }
+                        out.on_completed();
+                    }
+                    Rx::detail::close_async(completed);
+                });
+                out.add([=]() {
+                    Rx::detail::cancel_async(aop);
+                });
+            })
+            .as_dynamic()
+            .publish()
+            .ref_count();
+    }
+}
+
+template<class Observe>
+void measure(const char* name, long count, int subscribers, Observe observe) {
+    long total = 0;
+    long sum = 0;
+    auto seconds = bench_seconds([&]() {
+        for (long i = 0; i < count; ++i) {
+            auto op = fake::make_async<int>();
+            auto before = allocations.load();
+            {
+                auto source = observe(op.aop);
+                for (int s = 0; s < subscribers; ++s) {
+                    source.subscribe([&sum](int v) { sum += v; });
+                }
+                op.state->complete(1);
+            }
+            total += allocations.load() - before;
+        }
+    });
+    if (sum != count * subscribers) {
+        std::printf("%s: %ld of %ld values delivered\n", name, sum, count * subscribers);
+    }
+    std::printf("%-48s %6.1f allocations/op %8.1f ns/op\n", name, double(total) / count, seconds * 1e9 / count);
+}
+
+int main(int argc, char** argv) {
+    auto count = bench_count(100000, bench_scale(argc, argv));
+    typedef Windows::Foundation::IAsyncOperation<int> async_type;
+
+    measure("create/publish/ref_count, 1 subscriber", count, 1, [](const async_type& aop) {
+        return previous::from_async<int>(aop);
+    });
+    measure("from_async, 1 subscriber", count, 1, [](const async_type& aop) {
+        return Rx::from_async(aop);
+    });
+    measure("create/publish/ref_count, 2 subscribers", count, 2, [](const async_type& aop) {
+        return previous::from_async<int>(aop);
+    });
+    measure("from_async, 2 subscribers", count, 2, [](const async_type& aop) {
+        return Rx::from_async(aop);
+    });
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "bench.h"
+#include "fake_async.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Modern;
+
+// latency from an operation completing to its result and completion arriving
+// on the dispatcher, and the items posted to the dispatcher per operation -
+// from_async(aop).observe_on(cn) against from_async(aop, cn). the operation
+// completes either on another thread or on the dispatcher thread itself.
+//
+// then the cost of a burst of schedules onto the dispatcher - the batched
+// core_dispatcher against a worker that posts every schedulable on its own.
+
+typedef std::chrono::steady_clock clock_type;
+typedef Windows::Foundation::IAsyncOperation<int> async_type;
+
+namespace {
+
+    struct sample
+    {
+        clock_type::time_point completed;
+        clock_type::time_point next;
+        clock_type::time_point done;
+        std::atomic<bool> finished;
+        bool on_dispatcher;
+    };
+
+    double median_us(std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        return v.empty() ? 0 : v[v.size() / 2];
+    }
+
+    double p99_us(std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        return v.empty() ? 0 : v[v.size() * 99 / 100];
+    }
+
+    // the worker core_dispatcher replaced - one post per schedulable
+    struct post_per_item : public Rx::schedulers::scheduler_interface
+    {
+    private:
+        typedef post_per_item this_type;
+        post_per_item(const this_type&);
+
+        struct post_per_item_worker : public Rx::schedulers::worker_interface
+        {
+            std::shared_ptr<Rx::core_dispatcher_thread> dispatcher;
+
+            explicit post_per_item_worker(std::shared_ptr<Rx::core_dispatcher_thread> dispatcher)
+                : dispatcher(std::move(dispatcher))
+            {
+            }
+
+            virtual clock_type::time_point now() const {
+                return clock_type::now();
+            }
+
+            virtual void schedule(const Rx::schedulable& scbl) const {
+                dispatcher->post([scbl]() {
+                    if (scbl.is_subscribed()) {
+                        Rx::schedulers::recursion r(false);
+                        scbl(r.get_recurse());
+                    }
+                });
+            }
+
+            virtual void schedule(clock_type::time_point, const Rx::schedulable& scbl) const {
+                schedule(scbl);
+            }
+        };
+
+        std::shared_ptr<post_per_item_worker> wi;
+
+    public:
+        explicit post_per_item(std::shared_ptr<Rx::core_dispatcher_thread> dispatcher)
+            : wi(std::make_shared<post_per_item_worker>(std::move(dispatcher)))
+        {
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual Rx::worker create_worker(Rx::composite_subscription cs) const {
+            return Rx::worker(std::move(cs), wi);
+        }
+    };
+
+    void measure_burst(const char* name, long count, long burst, const std::shared_ptr<Rx::core_dispatcher_thread>& dispatcher, Rx::scheduler sc) {
+        auto w = sc.create_worker();
+        auto posted = dispatcher->posted();
+        std::atomic<long> ran(0);
+        auto seconds = bench_seconds([&]() {
+            for (long i = 0; i < count; i += burst) {
+                for (long b = 0; b < burst; ++b) {
+                    w.schedule(Rx::schedulers::make_schedulable(w, [&ran](const Rx::schedulable&) {
+                        ++ran;
+                    }));
+                }
+                while (ran.load() < i + burst) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        std::printf("%-52s %7.1f ns/item %5.3f posts/item\n",
+            name, seconds * 1e9 / count, double(dispatcher->posted() - posted) / count);
+    }
+
+    template<class Observe>
+    void measure(const char* name, long count, bool complete_on_dispatcher, const std::shared_ptr<Rx::core_dispatcher_thread>& dispatcher, Observe observe) {
+        std::vector<double> next_us, done_us;
+        long off_thread = 0;
+        auto posted = dispatcher->posted();
+
+        for (long i = 0; i < count; ++i) {
+            auto op = fake::make_async<int>();
+            sample s;
+            s.finished = false;
+            s.on_dispatcher = true;
+
+            auto lifetime = observe(op.aop).subscribe(
+                [&](int) {
+                    s.next = clock_type::now();
+                    s.on_dispatcher = s.on_dispatcher && dispatcher->HasThreadAccess();
+                },
+                [&](std::exception_ptr) {
+                    s.finished = true;
+                },
+                [&]() {
+                    s.done = clock_type::now();
+                    s.on_dispatcher = s.on_dispatcher && dispatcher->HasThreadAccess();
+                    s.finished = true;
+                });
+
+            auto state = op.state;
+            if (complete_on_dispatcher) {
+                ++posted;
+                dispatcher->post([&s, state]() {
+                    s.completed = clock_type::now();
+                    state->complete(1);
+                });
+            }
+            else {
+                s.completed = clock_type::now();
+                state->complete(1);
+            }
+            while (!s.finished) {
+                std::this_thread::yield();
+            }
+
+            off_thread += s.on_dispatcher ? 0 : 1;
+            next_us.push_back(std::chrono::duration<double, std::micro>(s.next - s.completed).count());
+            done_us.push_back(std::chrono::duration<double, std::micro>(s.done - s.completed).count());
+        }
+
+        std::printf("%-52s next %7.2f us (p99 %7.2f) completed %7.2f us %5.2f posts/op\n",
+            name, median_us(next_us), p99_us(next_us), median_us(done_us), double(dispatcher->posted() - posted) / count);
+        if (off_thread != 0) {
+            std::printf("%s: %ld deliveries off the dispatcher\n", name, off_thread);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    auto count = bench_count(20000, bench_scale(argc, argv));
+    auto dispatcher = std::make_shared<Rx::core_dispatcher_thread>();
+    auto cn = Rx::identity_core_dispatcher(dispatcher);
+
+    auto hop = [cn](const async_type& aop) {
+        return Rx::from_async(aop).observe_on(cn);
+    };
+    auto direct = [cn](const async_type& aop) {
+        return Rx::from_async(aop, cn);
+    };
+
+    measure("observe_on, completed on another thread", count, false, dispatcher, hop);
+    measure("from_async(aop, cn), completed on another thread", count, false, dispatcher, direct);
+    measure("observe_on, completed on the dispatcher", count, true, dispatcher, hop);
+    measure("from_async(aop, cn), completed on the dispatcher", count, true, dispatcher, direct);
+
+    const long burst = 100;
+    auto items = bench_count(1000000, bench_scale(argc, argv)) / burst * burst;
+    items = items < burst ? burst : items;
+    measure_burst("bursts of 100, a post per item", items, burst, dispatcher, Rx::make_scheduler<post_per_item>(dispatcher));
+    measure_burst("bursts of 100, batched core_dispatcher", items, burst, dispatcher, Rx::make_core_dispatcher(dispatcher));
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "bench.h"
+#include "fake_async.h"
+
+#include <thread>
+#include <vector>
+
+using namespace Modern;
+
+// failed operations through from_async - GetResults throws and the consumer
+// rethrows the exception_ptr to read the HRESULT - against from_async_result,
+// where the HRESULT arrives as a value. measured at several failure rates and
+// from several threads at once, where unwinding contends.
+
+typedef Windows::Foundation::IAsyncOperation<int> async_type;
+
+static long run_throwing(long count, int fail_every) {
+    long failures = 0;
+    for (long i = 0; i < count; ++i) {
+        auto op = fake::make_async<int>();
+        Rx::from_async(op.aop).subscribe(
+            [](int) {},
+            [&failures](std::exception_ptr ep) {
+                try { std::rethrow_exception(ep); }
+                catch (const Modern::Exception& ex) { failures += FAILED(ex.Result) ? 1 : 0; }
+            });
+        if (fail_every != 0 && i % fail_every == 0) {
+            op.state->fail(RPC_E_DISCONNECTED);
+        }
+        else {
+            op.state->complete(1);
+        }
+    }
+    return failures;
+}
+
+static long run_values(long count, int fail_every) {
+    long failures = 0;
+    for (long i = 0; i < count; ++i) {
+        auto op = fake::make_async<int>();
+        Rx::from_async_result(op.aop).subscribe(
+            [&failures](const Rx::async_result<int>& r) {
+                failures += r.succeeded() ? 0 : 1;
+            });
+        if (fail_every != 0 && i % fail_every == 0) {
+            op.state->fail(RPC_E_DISCONNECTED);
+        }
+        else {
+            op.state->complete(1);
+        }
+    }
+    return failures;
+}
+
+template<class Run>
+void measure(const std::string& name, long count, int fail_every, unsigned threads, Run run) {
+    std::vector<long> failures(threads);
+    auto seconds = bench_seconds([&]() {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                failures[t] = run(count, fail_every);
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+    });
+    long expected = fail_every == 0 ? 0 : (count + fail_every - 1) / fail_every;
+    for (auto f : failures) {
+        if (f != expected) {
+            std::printf("%s: %ld failures, expected %ld\n", name.c_str(), f, expected);
+        }
+    }
+    bench_report(name, count * threads, seconds);
+}
+
+int main(int argc, char** argv) {
+    auto count = bench_count(100000, bench_scale(argc, argv));
+    auto cores = std::thread::hardware_concurrency();
+    cores = cores < 2 ? 2 : cores;
+
+    const int rates[] = {0, 10, 1};
+    const char* labels[] = {"no failures", "1 in 10 fail", "all fail"};
+    for (unsigned threads : {1u, cores}) {
+        for (int r = 0; r < 3; ++r) {
+            auto suffix = std::string(", ") + labels[r] + ", " + std::to_string(threads) + " thread(s)";
+            measure("from_async" + suffix, count, rates[r], threads, run_throwing);
+            measure("from_async_result" + suffix, count, rates[r], threads, run_values);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "bench.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// throughput of the work-stealing pool against the pool it replaces - one
+// locked queue shared by every thread, with an allocation per item. both are
+// schedulers, so both sides pay the same schedulable and worker costs and the
+// difference is the queueing and waking alone.
+
+namespace {
+
+    class locked_queue_state
+    {
+        typedef locked_queue_state this_type;
+        locked_queue_state(const this_type&);
+
+        std::mutex lock;
+        std::condition_variable wake;
+        std::deque<Rx::schedulable*> items;
+        std::vector<std::thread> threads;
+        bool stopping;
+
+    public:
+        locked_queue_state()
+            : stopping(false)
+        {
+        }
+        ~locked_queue_state()
+        {
+            for (auto item : items) {
+                delete item;
+            }
+        }
+
+        void start(size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                threads.emplace_back([this]() {
+                    run();
+                });
+            }
+        }
+
+        void stop() {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                stopping = true;
+                wake.notify_all();
+            }
+            for (auto& t : threads) {
+                t.join();
+            }
+        }
+
+        void submit(const Rx::schedulable& scbl) {
+            auto item = new Rx::schedulable(scbl);
+            std::unique_lock<std::mutex> guard(lock);
+            items.push_back(item);
+            wake.notify_one();
+        }
+
+    private:
+        void run() {
+            std::unique_lock<std::mutex> guard(lock);
+            for (;;) {
+                wake.wait(guard, [this]() {
+                    return stopping || !items.empty();
+                });
+                if (stopping) {
+                    return;
+                }
+                std::unique_ptr<Rx::schedulable> item(items.front());
+                items.pop_front();
+                guard.unlock();
+                if (item->is_subscribed()) {
+                    Rx::schedulers::recursion r(true);
+                    (*item)(r.get_recurse());
+                }
+                item.reset();
+                guard.lock();
+            }
+        }
+    };
+
+    struct locked_queue_pool : public Rx::schedulers::scheduler_interface
+    {
+    private:
+        typedef locked_queue_pool this_type;
+        locked_queue_pool(const this_type&);
+
+        struct locked_queue_worker : public Rx::schedulers::worker_interface
+        {
+            std::shared_ptr<locked_queue_state> state;
+
+            explicit locked_queue_worker(std::shared_ptr<locked_queue_state> state)
+                : state(std::move(state))
+            {
+            }
+
+            virtual clock_type::time_point now() const {
+                return clock_type::now();
+            }
+
+            virtual void schedule(const Rx::schedulable& scbl) const {
+                state->submit(scbl);
+            }
+
+            virtual void schedule(clock_type::time_point, const Rx::schedulable& scbl) const {
+                state->submit(scbl);
+            }
+        };
+
+        std::shared_ptr<locked_queue_state> state;
+        std::shared_ptr<locked_queue_worker> wi;
+
+    public:
+        explicit locked_queue_pool(size_t threads)
+            : state(std::make_shared<locked_queue_state>())
+            , wi(std::make_shared<locked_queue_worker>(state))
+        {
+            state->start(threads);
+        }
+        virtual ~locked_queue_pool()
+        {
+            state->stop();
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual Rx::worker create_worker(Rx::composite_subscription cs) const {
+            return Rx::worker(std::move(cs), wi);
+        }
+    };
+
+    void wait_for(const std::atomic<long>& done, long count) {
+        while (done.load() < count) {
+            std::this_thread::yield();
+        }
+    }
+
+    // a binary tree of tasks - each schedules its two children from inside
+    // the pool, the pattern the per-thread deques are for
+    void fan_out(const Rx::worker& w, std::atomic<long>& done, int depth) {
+        ++done;
+        if (depth == 0) {
+            return;
+        }
+        for (int i = 0; i < 2; ++i) {
+            w.schedule(Rx::schedulers::make_schedulable(w, [w, &done, depth](const Rx::schedulable&) {
+                fan_out(w, done, depth - 1);
+            }));
+        }
+    }
+
+    int depth_for(long items) {
+        int depth = 0;
+        while ((2L << (depth + 1)) - 1 <= items) {
+            ++depth;
+        }
+        return depth;
+    }
+}
+
+int main(int argc, char** argv) {
+    auto scale = bench_scale(argc, argv);
+    auto threads = std::thread::hardware_concurrency();
+    threads = threads < 2 ? 2 : threads;
+    std::printf("%u threads\n", threads);
+
+    auto items = bench_count(1000000, scale);
+    auto depth = depth_for(items);
+    auto tree = (2L << depth) - 1;
+
+    struct
+    {
+        const char* name;
+        Rx::scheduler pool;
+    } pools[] = {
+        {"locked queue", Rx::make_scheduler<locked_queue_pool>(threads)},
+        {"work stealing", Rx::make_work_stealing_pool(threads)}
+    };
+
+    for (auto& p : pools) {
+        auto w = p.pool.create_worker();
+        std::atomic<long> done(0);
+        auto seconds = bench_seconds([&]() {
+            for (long i = 0; i < items; ++i) {
+                w.schedule(Rx::schedulers::make_schedulable(w, [&done](const Rx::schedulable&) { ++done; }));
+            }
+            wait_for(done, items);
+        });
+        bench_report(std::string(p.name) + ", submitted from outside", items, seconds);
+    }
+    for (auto& p : pools) {
+        auto w = p.pool.create_worker();
+        std::atomic<long> done(0);
+        auto seconds = bench_seconds([&]() {
+            w.schedule(Rx::schedulers::make_schedulable(w, [&](const Rx::schedulable&) { fan_out(w, done, depth); }));
+            wait_for(done, tree);
+        });
+        bench_report(std::string(p.name) + ", fan-out inside the pool", tree, seconds);
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// the tests are plain programs run by ctest - a failed check prints where it
+// failed and the test exits non-zero at the end of main
+inline int& check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(expr) \
+    do { \
+        if (!(expr)) { \
+            std::printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #expr); \
+            ++check_failures(); \
+        } \
+    } while (false)
+
+inline int check_result() {
+    if (check_failures() != 0) {
+        std::printf("%d check(s) failed\n", check_failures());
+        return EXIT_FAILURE;
+    }
+    std::printf("passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,332 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// the batched dispatcher drain, posting to a queue of callbacks that each
+// case runs by hand - or, for the handshake, from a thread of its own.
+
+typedef Rx::timer_wheel::clock_type clock_type;
+typedef std::chrono::milliseconds ms;
+
+namespace {
+
+    // stands in for the dispatcher - what is posted waits here until run
+    class manual_dispatcher
+    {
+        typedef manual_dispatcher this_type;
+        manual_dispatcher(const this_type&);
+
+        std::mutex lock;
+        std::deque<std::function<void()>> items;
+        long count;
+
+    public:
+        manual_dispatcher()
+            : count(0)
+        {
+        }
+
+        void post(std::function<void()> item) {
+            std::unique_lock<std::mutex> guard(lock);
+            items.push_back(std::move(item));
+            ++count;
+        }
+
+        long posted() {
+            std::unique_lock<std::mutex> guard(lock);
+            return count;
+        }
+
+        size_t waiting() {
+            std::unique_lock<std::mutex> guard(lock);
+            return items.size();
+        }
+
+        // runs one posted callback. false when there was none
+        bool run_one() {
+            std::function<void()> item;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (items.empty()) {
+                    return false;
+                }
+                item = std::move(items.front());
+                items.pop_front();
+            }
+            item();
+            return true;
+        }
+    };
+
+    struct queue_scheduler : public Rx::schedulers::scheduler_interface
+    {
+    private:
+        typedef queue_scheduler this_type;
+        queue_scheduler(const this_type&);
+
+        struct queue_worker : public Rx::schedulers::worker_interface
+        {
+            std::shared_ptr<Rx::dispatcher_queue> queue;
+
+            explicit queue_worker(std::shared_ptr<Rx::dispatcher_queue> queue)
+                : queue(std::move(queue))
+            {
+            }
+
+            virtual clock_type::time_point now() const {
+                return clock_type::now();
+            }
+
+            virtual void schedule(const Rx::schedulable& scbl) const {
+                queue->schedule(clock_type::time_point(), scbl);
+            }
+
+            virtual void schedule(clock_type::time_point when, const Rx::schedulable& scbl) const {
+                queue->schedule(when, scbl);
+            }
+        };
+
+        std::shared_ptr<queue_worker> wi;
+
+    public:
+        explicit queue_scheduler(std::shared_ptr<Rx::dispatcher_queue> queue)
+            : wi(std::make_shared<queue_worker>(std::move(queue)))
+        {
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual Rx::worker create_worker(Rx::composite_subscription cs) const {
+            return Rx::worker(std::move(cs), wi);
+        }
+    };
+
+    struct fixture
+    {
+        explicit fixture(clock_type::duration budget = ms(4))
+            : dispatcher(std::make_shared<manual_dispatcher>())
+            , jitter(std::make_shared<Rx::detail::run_jitter>())
+        {
+            auto d = dispatcher;
+            queue = std::make_shared<Rx::dispatcher_queue>(
+                [d](std::function<void()> drain) {
+                    d->post(std::move(drain));
+                },
+                Rx::shared_thread_timer_wheel(), budget, clock_type::duration::zero(), nullptr, jitter);
+            w = Rx::make_scheduler<queue_scheduler>(queue).create_worker();
+        }
+
+        template<class F>
+        void schedule(F f) {
+            w.schedule(Rx::schedulers::make_schedulable(w, [f](const Rx::schedulable&) {
+                f();
+            }));
+        }
+
+        std::shared_ptr<manual_dispatcher> dispatcher;
+        std::shared_ptr<Rx::detail::run_jitter> jitter;
+        std::shared_ptr<Rx::dispatcher_queue> queue;
+        Rx::worker w;
+    };
+
+    void spin_for(clock_type::duration d) {
+        auto until = clock_type::now() + d;
+        while (clock_type::now() < until) {
+        }
+    }
+}
+
+static void many_schedules_one_post() {
+    fixture f;
+    std::vector<int> ran;
+    for (int i = 0; i < 100; ++i) {
+        f.schedule([&ran, i]() {
+            ran.push_back(i);
+        });
+    }
+    CHECK(f.dispatcher->posted() == 1);
+    CHECK(ran.empty());
+
+    CHECK(f.dispatcher->run_one());
+    CHECK(ran.size() == 100);
+    bool ordered = true;
+    for (int i = 0; i < static_cast<int>(ran.size()); ++i) {
+        ordered = ordered && ran[i] == i;
+    }
+    CHECK(ordered);
+    // drained dry - nothing posted again
+    CHECK(f.dispatcher->waiting() == 0);
+
+    auto counters = f.queue->get_counters();
+    CHECK(counters->slices == 1);
+    CHECK(counters->items == 100);
+    CHECK(counters->queued == 0);
+
+    // the flag was cleared - the next schedule posts again
+    f.schedule([&ran]() {
+        ran.push_back(100);
+    });
+    CHECK(f.dispatcher->posted() == 2);
+    CHECK(f.dispatcher->run_one());
+    CHECK(ran.size() == 101);
+}
+
+static void schedules_from_a_drain_join_it() {
+    fixture f;
+    int ran = 0;
+    f.schedule([&]() {
+        ++ran;
+        // pushed while the drain is running - no second post
+        f.schedule([&]() {
+            ++ran;
+        });
+    });
+    CHECK(f.dispatcher->run_one());
+    CHECK(ran == 2);
+    CHECK(f.dispatcher->posted() == 1);
+    CHECK(f.dispatcher->waiting() == 0);
+}
+
+static void yields_after_the_budget() {
+    fixture f(ms(4));
+    const int count = 10;
+    int ran = 0;
+    for (int i = 0; i < count; ++i) {
+        f.schedule([&]() {
+            ++ran;
+            spin_for(ms(2));
+        });
+    }
+    CHECK(f.dispatcher->posted() == 1);
+
+    CHECK(f.dispatcher->run_one());
+    // out of budget after two items, or one if the thread was preempted
+    // inside it - the drain posted itself again
+    CHECK(ran < count);
+    CHECK(ran >= 1);
+    CHECK(f.dispatcher->waiting() == 1);
+
+    int drains = 1;
+    while (f.dispatcher->run_one()) {
+        ++drains;
+    }
+    CHECK(ran == count);
+    CHECK(drains >= count / 3);
+    CHECK(f.queue->get_counters()->slices == drains);
+    CHECK(f.queue->get_counters()->overruns > 0);
+}
+
+static void a_throw_keeps_the_queue_moving() {
+    fixture f;
+    int ran = 0;
+    f.schedule([&]() {
+        ++ran;
+    });
+    f.schedule([&]() {
+        ++ran;
+        throw std::runtime_error("item");
+    });
+    f.schedule([&]() {
+        ++ran;
+    });
+
+    bool thrown = false;
+    try {
+        f.dispatcher->run_one();
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(ran == 2);
+    // the rest wait for a drain posted before the throw
+    CHECK(f.dispatcher->waiting() == 1);
+    CHECK(f.dispatcher->run_one());
+    CHECK(ran == 3);
+    CHECK(f.dispatcher->waiting() == 0);
+}
+
+static void delayed_items_report_jitter() {
+    fixture f;
+    auto due = clock_type::now() - ms(3);
+    bool ran = false;
+    f.w.schedule(due, Rx::schedulers::make_schedulable(f.w, [&](const Rx::schedulable&) {
+        ran = true;
+    }));
+    CHECK(f.dispatcher->run_one());
+    CHECK(ran);
+    auto jitter = f.jitter->get();
+    CHECK(jitter.fired == 1);
+    CHECK(jitter.worst >= ms(3));
+}
+
+static void nothing_stranded_across_the_handshake() {
+    // producers push while the drain clears its posted flag. an item that
+    // lands between the last take and the clear must still run.
+    fixture f(ms(1));
+    const int producers = 3;
+    const int count = 20000;
+    std::atomic<int> ran(0);
+    std::atomic<bool> done(false);
+
+    std::thread consumer([&]() {
+        while (!done) {
+            if (!f.dispatcher->run_one()) {
+                std::this_thread::yield();
+            }
+        }
+        while (f.dispatcher->run_one()) {
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < count; ++i) {
+                f.schedule([&]() {
+                    ++ran;
+                });
+                if ((i + p) % 7 == 0) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    auto until = clock_type::now() + std::chrono::seconds(10);
+    while (ran < producers * count && clock_type::now() < until) {
+        std::this_thread::yield();
+    }
+    done = true;
+    consumer.join();
+
+    CHECK(ran == producers * count);
+    CHECK(f.queue->get_counters()->queued == 0);
+    // batched - far fewer posts than items
+    CHECK(f.dispatcher->posted() < producers * count / 4);
+}
+
+int main() {
+    many_schedules_one_post();
+    schedules_from_a_drain_join_it();
+    yields_after_the_budget();
+    a_throw_keeps_the_queue_moving();
+    delayed_items_report_jitter();
+    nothing_stranded_across_the_handshake();
+    return check_result();
+}
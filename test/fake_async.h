@@ -0,0 +1,181 @@
+#pragma once
+
+// an IAsyncOperation<Result> that the test completes, fails or cancels, and
+// that counts the calls to Cancel and Close made through IAsyncInfo.
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace fake {
+
+    struct async_counters
+    {
+        async_counters()
+            : cancels(0)
+            , closes(0)
+        {
+        }
+
+        std::atomic<int> cancels;
+        std::atomic<int> closes;
+    };
+
+    template<class Result>
+    struct async_operation : public Modern::Implements<Modern::ABI::Windows::Foundation::IAsyncOperation<Modern::Abi<Result>>, Modern::ABI::Windows::IAsyncInfo>
+    {
+        typedef Modern::Windows::Foundation::IAsyncOperation<Result> async_type;
+        typedef Modern::ABI::Windows::Foundation::IAsyncOperation<Modern::Abi<Result>> abi_type;
+        typedef Modern::ABI::Windows::Foundation::IAsyncOperationCompletedHandler<Modern::Abi<Result>> handler_type;
+
+        explicit async_operation(std::shared_ptr<async_counters> counters = std::make_shared<async_counters>())
+            : counters(std::move(counters))
+            , status(Modern::AsyncStatus::Started)
+            , error(S_OK)
+            , result()
+            , closed(false)
+        {
+        }
+
+        async_type get() {
+            async_type r;
+            this->AddRef();
+            attach(r, static_cast<abi_type*>(this));
+            return r;
+        }
+
+        void complete(Result value) {
+            finish(Modern::AsyncStatus::Completed, S_OK, std::move(value));
+        }
+
+        void fail(HRESULT hr) {
+            finish(Modern::AsyncStatus::Error, hr, Result());
+        }
+
+        bool has_handler() const {
+            std::unique_lock<std::mutex> guard(lock);
+            return !!handler;
+        }
+
+        // IAsyncOperation
+
+        virtual HRESULT __stdcall put_Completed(handler_type* value) noexcept override {
+            std::unique_lock<std::mutex> guard(lock);
+            if (closed) {
+                return E_ILLEGAL_METHOD_CALL;
+            }
+            if (handler) {
+                return E_ILLEGAL_DELEGATE_ASSIGNMENT;
+            }
+            handler.CopyFrom(value);
+            if (status == Modern::AsyncStatus::Started) {
+                return S_OK;
+            }
+            auto h = handler;
+            auto s = status;
+            guard.unlock();
+            // an operation that has finished calls the handler inline
+            return h->abi_Invoke(this, s);
+        }
+
+        virtual HRESULT __stdcall get_Completed(handler_type** value) noexcept override {
+            std::unique_lock<std::mutex> guard(lock);
+            handler.CopyTo(value);
+            return S_OK;
+        }
+
+        virtual HRESULT __stdcall abi_GetResults(Modern::ABI::ArgOut<Modern::Abi<Result>> value) noexcept override {
+            std::unique_lock<std::mutex> guard(lock);
+            switch (status) {
+            case Modern::AsyncStatus::Completed:
+                *value = result;
+                return S_OK;
+            case Modern::AsyncStatus::Error:
+                return error;
+            case Modern::AsyncStatus::Canceled:
+                return HRESULT_FROM_WIN32(ERROR_CANCELLED);
+            default:
+                return E_ILLEGAL_METHOD_CALL;
+            }
+        }
+
+        // IAsyncInfo
+
+        virtual HRESULT __stdcall get_Id(unsigned int* id) noexcept override {
+            *id = 1;
+            return S_OK;
+        }
+
+        virtual HRESULT __stdcall get_Status(Modern::AsyncStatus* value) noexcept override {
+            std::unique_lock<std::mutex> guard(lock);
+            if (closed) {
+                return E_ILLEGAL_METHOD_CALL;
+            }
+            *value = status;
+            return S_OK;
+        }
+
+        virtual HRESULT __stdcall get_ErrorCode(HRESULT* value) noexcept override {
+            std::unique_lock<std::mutex> guard(lock);
+            *value = error;
+            return S_OK;
+        }
+
+        virtual HRESULT __stdcall abi_Cancel() noexcept override {
+            ++counters->cancels;
+            finish(Modern::AsyncStatus::Canceled, HRESULT_FROM_WIN32(ERROR_CANCELLED), Result());
+            return S_OK;
+        }
+
+        virtual HRESULT __stdcall abi_Close() noexcept override {
+            ++counters->closes;
+            Modern::ComPtr<handler_type> released;
+            std::unique_lock<std::mutex> guard(lock);
+            closed = true;
+            swap(released, handler);
+            guard.unlock();
+            return S_OK;
+        }
+
+        std::shared_ptr<async_counters> counters;
+
+    private:
+        void finish(Modern::AsyncStatus s, HRESULT hr, Result value) {
+            std::unique_lock<std::mutex> guard(lock);
+            if (status != Modern::AsyncStatus::Started) {
+                return;
+            }
+            status = s;
+            error = hr;
+            result = std::move(value);
+            auto h = handler;
+            guard.unlock();
+            if (h) {
+                h->abi_Invoke(this, s);
+            }
+        }
+
+        mutable std::mutex lock;
+        Modern::AsyncStatus status;
+        HRESULT error;
+        Result result;
+        bool closed;
+        Modern::ComPtr<handler_type> handler;
+    };
+
+    // a new operation and the projection that owns it
+    template<class Result>
+    struct async_pair
+    {
+        Modern::ComPtr<async_operation<Result>> state;
+        Modern::Windows::Foundation::IAsyncOperation<Result> aop;
+    };
+
+    template<class Result>
+    async_pair<Result> make_async(std::shared_ptr<async_counters> counters = std::make_shared<async_counters>()) {
+        async_pair<Result> r;
+        attach(r.state, new async_operation<Result>(std::move(counters)));
+        r.aop = r.state->get();
+        return r;
+    }
+}
@@ -0,0 +1,200 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <thread>
+
+// frame_budget takes the time as an argument, so most of this runs on a
+// virtual clock. the last case drives a framed dispatcher_queue through a
+// wheel that only moves when the test advances it.
+
+typedef Rx::timer_wheel::clock_type clock_type;
+typedef std::chrono::milliseconds ms;
+
+static const clock_type::time_point t0 = clock_type::time_point(std::chrono::hours(1000));
+
+static void a_new_frame_resets_spent() {
+    Rx::detail::frame_budget budget(ms(4), ms(16));
+    CHECK(budget.framed());
+
+    bool new_frame = false;
+    CHECK(budget.begin(t0, new_frame));
+    CHECK(new_frame);
+    CHECK(budget.deadline(t0) == t0 + ms(4));
+    CHECK(budget.end(t0, t0 + ms(3)) == clock_type::duration::zero());
+
+    // the same frame - only what is left of the budget
+    CHECK(budget.begin(t0 + ms(5), new_frame));
+    CHECK(!new_frame);
+    CHECK(budget.deadline(t0 + ms(5)) == t0 + ms(6));
+    // exactly spent is not an overrun
+    CHECK(budget.end(t0 + ms(5), t0 + ms(6)) == clock_type::duration::zero());
+
+    // spent - the drain has to wait for the next frame
+    CHECK(!budget.begin(t0 + ms(10), new_frame));
+    CHECK(!new_frame);
+    CHECK(budget.next_frame() == t0 + ms(16));
+
+    CHECK(budget.begin(t0 + ms(16), new_frame));
+    CHECK(new_frame);
+    CHECK(budget.deadline(t0 + ms(16)) == t0 + ms(20));
+    CHECK(budget.next_frame() == t0 + ms(32));
+}
+
+static void end_accounts_overruns() {
+    Rx::detail::frame_budget budget(ms(4), ms(16));
+    bool new_frame = false;
+    CHECK(budget.begin(t0, new_frame));
+    CHECK(budget.end(t0, t0 + ms(6)) == ms(2));
+    CHECK(!budget.begin(t0 + ms(7), new_frame));
+
+    // slices add up within a frame, and the overrun is of the frame
+    CHECK(budget.begin(t0 + ms(16), new_frame));
+    CHECK(new_frame);
+    CHECK(budget.end(t0 + ms(16), t0 + ms(19)) == clock_type::duration::zero());
+    CHECK(budget.begin(t0 + ms(20), new_frame));
+    CHECK(budget.end(t0 + ms(20), t0 + ms(22)) == ms(1));
+
+    // a late drain starts its frame where it begins, not on the old grid
+    CHECK(budget.begin(t0 + ms(50), new_frame));
+    CHECK(new_frame);
+    CHECK(budget.next_frame() == t0 + ms(66));
+}
+
+static void no_frame_gives_every_drain_a_whole_budget() {
+    Rx::detail::frame_budget budget(ms(4), clock_type::duration::zero());
+    CHECK(!budget.framed());
+
+    bool new_frame = false;
+    CHECK(budget.begin(t0, new_frame));
+    CHECK(new_frame);
+    CHECK(budget.end(t0, t0 + ms(10)) == ms(6));
+
+    // straight after an overrun - still a whole budget
+    CHECK(budget.begin(t0 + ms(10), new_frame));
+    CHECK(new_frame);
+    CHECK(budget.deadline(t0 + ms(10)) == t0 + ms(14));
+    CHECK(budget.end(t0 + ms(10), t0 + ms(11)) == clock_type::duration::zero());
+    CHECK(budget.begin(t0 + ms(11), new_frame));
+    CHECK(new_frame);
+}
+
+namespace {
+
+    struct queue_worker : public Rx::schedulers::worker_interface
+    {
+        std::shared_ptr<Rx::dispatcher_queue> queue;
+
+        explicit queue_worker(std::shared_ptr<Rx::dispatcher_queue> queue)
+            : queue(std::move(queue))
+        {
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual void schedule(const Rx::schedulable& scbl) const {
+            queue->schedule(clock_type::time_point(), scbl);
+        }
+
+        virtual void schedule(clock_type::time_point when, const Rx::schedulable& scbl) const {
+            queue->schedule(when, scbl);
+        }
+    };
+
+    void spin_for(clock_type::duration d) {
+        auto until = clock_type::now() + d;
+        while (clock_type::now() < until) {
+        }
+    }
+}
+
+static void a_spent_frame_waits_on_the_wheel() {
+    std::deque<std::function<void()>> posted;
+    // no arm function - the wheel moves only when advanced here
+    auto wheel = std::make_shared<Rx::timer_wheel>(std::chrono::microseconds(100));
+    auto counters = std::make_shared<Rx::dispatcher_budget_counters>();
+    const auto frame = ms(30);
+    auto queue = std::make_shared<Rx::dispatcher_queue>(
+        [&posted](std::function<void()> drain) {
+            posted.push_back(std::move(drain));
+        },
+        wheel, ms(2), frame, counters, std::make_shared<Rx::detail::run_jitter>());
+    Rx::worker w(Rx::composite_subscription(), std::make_shared<queue_worker>(queue));
+
+    const int count = 4;
+    int ran = 0;
+    clock_type::duration spin = ms(1) + std::chrono::microseconds(100);
+    for (int i = 0; i < count; ++i) {
+        w.schedule(Rx::schedulers::make_schedulable(w, [&](const Rx::schedulable&) {
+            ++ran;
+            spin_for(spin);
+        }));
+    }
+    CHECK(posted.size() == 1);
+
+    auto run_posted = [&]() {
+        auto drain = std::move(posted.front());
+        posted.pop_front();
+        drain();
+    };
+    // a 30ms wait may cascade through a coarser level before it fires
+    auto wake_for_next_frame = [&]() {
+        while (posted.empty() && wheel->size() != 0) {
+            wheel->advance(wheel->next_wake());
+        }
+    };
+
+    // two items spend the 2ms budget and overrun it - one, if the thread
+    // was preempted inside it
+    run_posted();
+    auto first = ran;
+    CHECK(first >= 1 && first < count);
+    CHECK(counters->frames == 1);
+    CHECK(counters->slices == 1);
+    CHECK(counters->overruns == 1);
+    CHECK(counters->worst_overrun_us > 0);
+    // the rest of the frame belongs to the UI - nothing posted, the next
+    // drain waits on the wheel for the next frame
+    CHECK(posted.empty());
+    CHECK(wheel->size() == 1);
+
+    // woken before the frame is over by the clock - begin() refuses and the
+    // drain goes back to the wheel without running anything
+    wake_for_next_frame();
+    CHECK(posted.size() == 1);
+    run_posted();
+    CHECK(ran == first);
+    CHECK(counters->slices == 1);
+    CHECK(posted.empty());
+    CHECK(wheel->size() == 1);
+
+    // the next frame by the clock. the rest fits in its budget, so the
+    // drain ends dry instead of waiting on the wheel again
+    spin = clock_type::duration::zero();
+    std::this_thread::sleep_for(frame);
+    wake_for_next_frame();
+    CHECK(posted.size() == 1);
+    run_posted();
+    CHECK(ran == count);
+    CHECK(counters->frames == 2);
+    CHECK(counters->slices == 2);
+    CHECK(counters->items == count);
+    CHECK(counters->queued == 0);
+    CHECK(counters->worst_queue_age_us >= 30000);
+    CHECK(posted.empty());
+    CHECK(wheel->size() == 0);
+}
+
+int main() {
+    a_new_frame_resets_spent();
+    end_accounts_overruns();
+    no_frame_gives_every_drain_a_whole_budget();
+    a_spent_frame_waits_on_the_wheel();
+    return check_result();
+}
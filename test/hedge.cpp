@@ -0,0 +1,86 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+#include "fake_async.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// hedge against stand-in operations, with the hedge timer on a wheel that
+// only moves when the test advances it.
+
+typedef Rx::timer_wheel::clock_type clock_type;
+typedef std::chrono::milliseconds ms;
+
+static void hedge_wins_and_cancels_the_first() {
+    std::vector<fake::async_pair<int>> ops;
+    auto wheel = std::make_shared<Rx::timer_wheel>(ms(1));
+    auto counters = std::make_shared<Rx::hedge_counters>();
+    // one sample is enough for the estimate to leave its fallback
+    auto estimate = std::make_shared<Rx::latency_estimate>(0.5, ms(10), 10, 1);
+
+    int value = 0;
+    bool completed = false;
+    auto lifetime = Rx::hedge([&]() {
+            ops.push_back(fake::make_async<int>());
+            return ops.back().aop;
+        }, estimate, counters, wheel)
+        .subscribe(
+            [&](int v) { value = v; },
+            [](std::exception_ptr) {},
+            [&]() { completed = true; });
+    CHECK(ops.size() == 1);
+    CHECK(counters->started == 1);
+
+    // the caller has been waiting for a while when the hedge fires
+    std::this_thread::sleep_for(ms(40));
+    wheel->advance(wheel->next_wake());
+    CHECK(ops.size() == 2);
+    CHECK(counters->fired == 1);
+
+    // and the hedge answers at once
+    ops[1].state->complete(7);
+    CHECK(value == 7);
+    CHECK(completed);
+    CHECK(counters->won == 1);
+    CHECK(ops[0].state->counters->cancels == 1);
+
+    // the sample is what the caller waited, from the first attempt - not the
+    // moment the hedge took, which would pull the threshold down
+    CHECK(estimate->threshold() >= ms(40));
+    lifetime.unsubscribe();
+}
+
+static void the_first_attempt_wins_without_a_hedge() {
+    std::vector<fake::async_pair<int>> ops;
+    auto wheel = std::make_shared<Rx::timer_wheel>(ms(1));
+    auto counters = std::make_shared<Rx::hedge_counters>();
+
+    int value = 0;
+    auto lifetime = Rx::hedge([&]() {
+            ops.push_back(fake::make_async<int>());
+            return ops.back().aop;
+        }, ms(10), counters, wheel)
+        .subscribe(
+            [&](int v) { value = v; },
+            [](std::exception_ptr) {},
+            []() {});
+    CHECK(wheel->size() == 1);
+
+    ops[0].state->complete(3);
+    CHECK(value == 3);
+    // the hedge timer is canceled with the win
+    CHECK(wheel->size() == 0);
+    CHECK(ops.size() == 1);
+    CHECK(counters->fired == 0);
+    CHECK(counters->won == 0);
+    lifetime.unsubscribe();
+}
+
+int main() {
+    hedge_wins_and_cancels_the_first();
+    the_first_attempt_wins_without_a_hedge();
+    return check_result();
+}
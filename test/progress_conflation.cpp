@@ -0,0 +1,200 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// progress conflation on a worker that, like the thread pool, does not
+// serialize what it runs. most cases hold the flushes in a queue and run them
+// by hand; the last lets pool threads race them.
+
+typedef Rx::scheduler::clock_type clock_type;
+typedef std::chrono::milliseconds ms;
+typedef Rx::detail::progress_conflation<int> conflation_type;
+
+namespace {
+
+    // what is scheduled waits here until run - in any order the case wants
+    struct manual_worker : public Rx::schedulers::worker_interface
+    {
+        mutable std::deque<Rx::schedulable> items;
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual void schedule(const Rx::schedulable& scbl) const {
+            items.push_back(scbl);
+        }
+
+        virtual void schedule(clock_type::time_point, const Rx::schedulable& scbl) const {
+            items.push_back(scbl);
+        }
+
+        void run_one() {
+            auto scbl = items.front();
+            items.pop_front();
+            Rx::schedulers::recursion r(true);
+            scbl(r.get_recurse());
+        }
+    };
+
+    struct fixture
+    {
+        explicit fixture(clock_type::duration interval = ms(100))
+            : inner(std::make_shared<manual_worker>())
+            , conflation(std::make_shared<conflation_type>(interval, Rx::worker(Rx::composite_subscription(), inner)))
+        {
+        }
+
+        std::shared_ptr<manual_worker> inner;
+        std::shared_ptr<conflation_type> conflation;
+        // emits as "1", completes as "done"
+        std::vector<std::string> seen;
+    };
+}
+
+static void finish_waits_for_the_pending_flush() {
+    fixture f;
+    auto emit = [&f](int p) {
+        f.seen.push_back(std::to_string(p));
+    };
+    f.conflation->post(1, emit);
+    f.conflation->post(2, emit);
+    CHECK(f.inner->items.size() == 1);
+
+    // a flush is pending - finish() leaves the last of it to that one
+    f.conflation->finish(emit, [&f]() {
+        f.seen.push_back("done");
+    });
+    CHECK(f.inner->items.size() == 1);
+
+    f.inner->run_one();
+    std::vector<std::string> expected = {"2", "done"};
+    CHECK(f.seen == expected);
+    CHECK(f.inner->items.empty());
+}
+
+static void finish_without_progress_flushes_once() {
+    fixture f;
+    auto emit = [&f](int p) {
+        f.seen.push_back(std::to_string(p));
+    };
+    f.conflation->finish(emit, [&f]() {
+        f.seen.push_back("done");
+    });
+    CHECK(f.inner->items.size() == 1);
+    f.inner->run_one();
+    std::vector<std::string> expected = {"done"};
+    CHECK(f.seen == expected);
+    CHECK(f.inner->items.empty());
+}
+
+static void progress_during_a_flush_schedules_again() {
+    fixture f;
+    bool again = true;
+    std::function<void(int)> emit;
+    emit = [&](int p) {
+        f.seen.push_back(std::to_string(p));
+        if (again) {
+            again = false;
+            // lands after the read, while the flush still holds the flag
+            f.conflation->post(p + 1, emit);
+        }
+    };
+    f.conflation->post(1, emit);
+    f.inner->run_one();
+    // not stranded - the flush that read 1 scheduled the next
+    CHECK(f.inner->items.size() == 1);
+    f.inner->run_one();
+    std::vector<std::string> expected = {"1", "2"};
+    CHECK(f.seen == expected);
+    CHECK(f.inner->items.empty());
+}
+
+static void finish_during_a_flush_completes_after_it() {
+    fixture f;
+    std::function<void(int)> emit;
+    emit = [&](int p) {
+        f.seen.push_back(std::to_string(p));
+        if (p == 1) {
+            // the last progress and the completion arrive mid-emit
+            f.conflation->post(2, emit);
+            f.conflation->finish(emit, [&f]() {
+                f.seen.push_back("done");
+            });
+        }
+    };
+    f.conflation->post(1, emit);
+    f.inner->run_one();
+    // the flush that was running takes both - no second flush beside it
+    std::vector<std::string> expected = {"1", "2", "done"};
+    CHECK(f.seen == expected);
+    CHECK(f.inner->items.empty());
+}
+
+static void one_reader_on_a_pool() {
+    // the pool runs flushes on any thread. the emit checks that no two
+    // overlap and that nothing is emitted after done.
+    auto cn = Rx::identity_one_worker(Rx::make_thread_pool());
+    for (int round = 0; round < 200; ++round) {
+        auto conflation = std::make_shared<conflation_type>(clock_type::duration::zero(), cn.create_coordinator().get_worker());
+        std::atomic<int> inside(0);
+        std::atomic<bool> overlapped(false);
+        std::atomic<bool> after_done(false);
+        std::atomic<bool> completed(false);
+        std::atomic<int> last(0);
+        auto emit = [&](int p) {
+            if (++inside != 1) {
+                overlapped = true;
+            }
+            if (completed) {
+                after_done = true;
+            }
+            last = p;
+            std::this_thread::yield();
+            --inside;
+        };
+        const int count = 50;
+        for (int p = 1; p <= count; ++p) {
+            conflation->post(p, emit);
+            if (p % 5 == 0) {
+                std::this_thread::yield();
+            }
+        }
+        conflation->finish(emit, [&]() {
+            if (inside != 0) {
+                overlapped = true;
+            }
+            completed = true;
+        });
+        auto until = clock_type::now() + std::chrono::seconds(5);
+        while (!completed && clock_type::now() < until) {
+            std::this_thread::yield();
+        }
+        CHECK(completed);
+        CHECK(!overlapped);
+        CHECK(!after_done);
+        // the last progress is never dropped
+        CHECK(last == count);
+        if (!completed || overlapped || after_done || last != count) {
+            break;
+        }
+    }
+}
+
+int main() {
+    finish_waits_for_the_pending_flush();
+    finish_without_progress_flushes_once();
+    progress_during_a_flush_schedules_again();
+    finish_during_a_flush_completes_after_it();
+    one_reader_on_a_pool();
+    return check_result();
+}
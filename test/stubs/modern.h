@@ -0,0 +1,1235 @@
+#pragma once
+
+// a stand-in for the parts of modern.h and the Windows SDK that the rx.modern
+// headers use, so that they build and run on linux. the ABI interfaces keep
+// the method names and signatures of modern/base.h, the projections keep the
+// names of their methods, and QueryInterface works on one tag per interface
+// instead of a GUID.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define __stdcall
+
+typedef std::int32_t HRESULT;
+typedef unsigned char boolean;
+
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define HRESULT_CODE(hr) ((hr) & 0xFFFF)
+#define HRESULT_FACILITY(hr) (((hr) >> 16) & 0x1fff)
+
+#define FACILITY_WIN32 7
+#define FACILITY_HTTP 25
+
+#define S_OK ((HRESULT)0L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_POINTER ((HRESULT)0x80004003L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_PENDING ((HRESULT)0x8000000AL)
+#define E_ILLEGAL_STATE_CHANGE ((HRESULT)0x8000000DL)
+#define E_ILLEGAL_METHOD_CALL ((HRESULT)0x8000000EL)
+#define E_ILLEGAL_DELEGATE_ASSIGNMENT ((HRESULT)0x80000018L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define RPC_E_DISCONNECTED ((HRESULT)0x80010108L)
+
+#define ERROR_NETNAME_DELETED 64L
+#define ERROR_SEM_TIMEOUT 121L
+#define ERROR_NO_DATA 232L
+#define WAIT_TIMEOUT 258L
+#define ERROR_SERVICE_NOT_ACTIVE 1062L
+#define ERROR_CANCELLED 1223L
+#define ERROR_CONNECTION_REFUSED 1225L
+#define ERROR_NETWORK_UNREACHABLE 1231L
+#define ERROR_HOST_UNREACHABLE 1232L
+#define ERROR_CONNECTION_ABORTED 1236L
+#define ERROR_TIMEOUT 1460L
+
+#define __HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | (FACILITY_WIN32 << 16) | 0x80000000)))
+
+// an inline function in the SDK as well - so not a constant expression
+inline HRESULT HRESULT_FROM_WIN32(long x) {
+    return __HRESULT_FROM_WIN32(x);
+}
+
+struct GUID
+{
+    const void* tag;
+};
+
+inline bool operator==(const GUID& l, const GUID& r) {
+    return l.tag == r.tag;
+}
+
+inline bool operator!=(const GUID& l, const GUID& r) {
+    return !(l == r);
+}
+
+namespace Modern {
+
+    template<class T>
+    GUID uuid_of() {
+        static const char tag = 0;
+        return GUID{&tag};
+    }
+}
+
+#define __uuidof(T) ::Modern::uuid_of<T>()
+
+struct IUnknown
+{
+    virtual HRESULT __stdcall QueryInterface(GUID const & id, void ** object) = 0;
+    virtual unsigned long __stdcall AddRef() = 0;
+    virtual unsigned long __stdcall Release() = 0;
+};
+
+struct IInspectable : IUnknown
+{
+};
+
+struct IAgileObject : IUnknown
+{
+};
+
+namespace Modern {
+
+enum class AsyncStatus
+{
+    Started = 0,
+    Completed,
+    Canceled,
+    Error,
+};
+
+struct Exception
+{
+    HRESULT Result;
+
+    explicit Exception(HRESULT const value) : Result(value)
+    {}
+};
+
+inline void check(HRESULT const result)
+{
+    if (result == S_OK)
+    {
+        return;
+    }
+
+    throw Exception(result);
+}
+
+template <typename T>
+HRESULT call(T inner) noexcept
+{
+    try
+    {
+        inner();
+    }
+    catch (Exception const & e)
+    {
+        return e.Result;
+    }
+    catch (std::bad_alloc const &)
+    {
+        return E_OUTOFMEMORY;
+    }
+    catch (std::exception const &)
+    {
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+struct BoolProxy
+{
+    BoolProxy & operator=(BoolProxy const &) = delete;
+
+    BoolProxy(bool & value) noexcept :
+        m_value(value)
+    {}
+
+    ~BoolProxy() noexcept
+    {
+        m_value = 0 != m_abi;
+    }
+
+    operator boolean * () noexcept
+    {
+        return &m_abi;
+    }
+
+private:
+
+    boolean m_abi = 0;
+    bool & m_value;
+};
+
+template <typename T>
+class ComPtr
+{
+    T * m_ptr = nullptr;
+
+    void InternalRelease() noexcept
+    {
+        T * temp = m_ptr;
+        if (temp)
+        {
+            m_ptr = nullptr;
+            temp->Release();
+        }
+    }
+
+public:
+
+    ComPtr() noexcept = default;
+    ComPtr(std::nullptr_t) noexcept {}
+
+    ComPtr(ComPtr const & other) noexcept :
+        m_ptr(other.m_ptr)
+    {
+        if (m_ptr)
+        {
+            m_ptr->AddRef();
+        }
+    }
+
+    ComPtr(ComPtr && other) noexcept :
+        m_ptr(other.m_ptr)
+    {
+        other.m_ptr = nullptr;
+    }
+
+    ~ComPtr() noexcept
+    {
+        InternalRelease();
+    }
+
+    ComPtr & operator=(ComPtr other) noexcept
+    {
+        swap(*this, other);
+        return *this;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return nullptr != m_ptr;
+    }
+
+    T * operator->() const noexcept
+    {
+        return m_ptr;
+    }
+
+    void CopyFrom(T * other) noexcept
+    {
+        if (other)
+        {
+            other->AddRef();
+        }
+        InternalRelease();
+        m_ptr = other;
+    }
+
+    void CopyTo(T ** other) const noexcept
+    {
+        if (m_ptr)
+        {
+            m_ptr->AddRef();
+        }
+        *other = m_ptr;
+    }
+
+    friend T * get(ComPtr const & object) noexcept
+    {
+        return object.m_ptr;
+    }
+
+    friend T ** set(ComPtr & object) noexcept
+    {
+        object.InternalRelease();
+        return &object.m_ptr;
+    }
+
+    friend void attach(ComPtr & object, T * value) noexcept
+    {
+        object.InternalRelease();
+        object.m_ptr = value;
+    }
+
+    friend T * detach(ComPtr & object) noexcept
+    {
+        T * temp = object.m_ptr;
+        object.m_ptr = nullptr;
+        return temp;
+    }
+
+    friend void swap(ComPtr & left, ComPtr & right) noexcept
+    {
+        std::swap(left.m_ptr, right.m_ptr);
+    }
+};
+
+template <typename ... Interfaces>
+class Implements : public Interfaces ...
+{
+    template <int = 0>
+    void * FindInterface(GUID const &) noexcept
+    {
+        return nullptr;
+    }
+
+    template <typename First, typename ... Rest>
+    void * FindInterface(GUID const & id) noexcept
+    {
+        if (id == __uuidof(First))
+        {
+            return static_cast<First *>(this);
+        }
+
+        return FindInterface<Rest ...>(id);
+    }
+
+    template <typename First, typename ... Rest>
+    void * BaseQueryInterface(GUID const & id) noexcept
+    {
+        if (id == __uuidof(::IUnknown) || id == __uuidof(::IInspectable))
+        {
+            return static_cast<First *>(this);
+        }
+
+        return FindInterface<First, Rest ...>(id);
+    }
+
+protected:
+
+    std::atomic<unsigned long> m_references{1};
+
+    Implements() noexcept = default;
+
+    virtual ~Implements() noexcept
+    {}
+
+public:
+
+    Implements(Implements const &) = delete;
+    Implements & operator=(Implements const &) = delete;
+
+    virtual HRESULT __stdcall QueryInterface(GUID const & id, void ** object) noexcept override
+    {
+        *object = BaseQueryInterface<Interfaces ...>(id);
+
+        if (nullptr == *object)
+        {
+            return E_NOINTERFACE;
+        }
+
+        static_cast<::IUnknown *>(*object)->AddRef();
+        return S_OK;
+    }
+
+    virtual unsigned long __stdcall AddRef() noexcept override
+    {
+        return ++m_references;
+    }
+
+    virtual unsigned long __stdcall Release() noexcept override
+    {
+        unsigned long const remaining = --m_references;
+
+        if (0 == remaining)
+        {
+            delete this;
+        }
+
+        return remaining;
+    }
+};
+
+template <typename T>
+struct Traits
+{
+    using Abi = T;
+};
+
+template <>
+struct Traits<bool>
+{
+    using Abi = boolean;
+};
+
+template <typename T>
+class HasGetAt
+{
+    template <typename U, typename = decltype(std::declval<U>().GetAt(0))> static constexpr bool Check(int) { return true;  }
+    template <typename> static constexpr bool Check(...) { return false; }
+
+public:
+
+    static constexpr bool Value = Check<T>(0);
+};
+
+template <typename T>
+using IsRandomAccess = typename std::enable_if<HasGetAt<T>::Value>::type *;
+
+template <typename T>
+using IsNotRandomAccess = typename std::enable_if<!HasGetAt<T>::Value>::type *;
+
+template <typename T>
+using IsPod = typename std::enable_if<std::is_pod<T>::value>::type *;
+
+template <typename T>
+using IsNotPod = typename std::enable_if<!std::is_pod<T>::value>::type *;
+
+template <typename T>
+using Abi = typename Traits<T>::Abi;
+
+template <typename T>
+using DefaultAbi = Abi<T>;
+
+template <typename T, IsPod<T> = nullptr>
+T const & abi(T const & value) noexcept
+{
+    return value;
+}
+
+template <typename T, IsPod<T> = nullptr>
+T * abi(T * value) noexcept
+{
+    return value;
+}
+
+template <typename T, IsNotPod<T> = nullptr>
+auto abi(T const & value) noexcept
+{
+    return get(value);
+}
+
+template <typename T, IsNotPod<T> = nullptr>
+auto abi(T * value) noexcept
+{
+    return set(*value);
+}
+
+inline BoolProxy abi(bool * value) noexcept
+{
+    return BoolProxy(*value);
+}
+
+template <typename T>
+struct ImplementsDefault : Implements<Abi<T>, ::IAgileObject>
+{
+    using Default = T;
+};
+
+namespace ABI {
+
+template <typename T, typename Enable = void>
+struct Argument
+{
+    using In = T;
+    using Out = T *;
+};
+
+template <typename T>
+struct Argument<T, typename std::enable_if<std::is_base_of<::IUnknown, T>::value>::type>
+{
+    using In = T *;
+    using Out = T **;
+};
+
+template <typename T>
+using ArgIn = typename Argument<T>::In;
+
+template <typename T>
+using ArgOut = typename Argument<T>::Out;
+
+}
+
+namespace ABI { namespace Windows {
+
+struct IAsyncInfo : ::IInspectable
+{
+    virtual HRESULT __stdcall get_Id(unsigned int * id) = 0;
+    virtual HRESULT __stdcall get_Status(AsyncStatus * status) = 0;
+    virtual HRESULT __stdcall get_ErrorCode(HRESULT * errorCode) = 0;
+    virtual HRESULT __stdcall abi_Cancel() = 0;
+    virtual HRESULT __stdcall abi_Close() = 0;
+};
+
+}}
+
+namespace ABI { namespace Windows { namespace Foundation {
+
+template <typename TResult> struct IAsyncOperation;
+template <typename TResult, typename TProgress> struct IAsyncOperationWithProgress;
+struct IAsyncAction;
+template <typename TProgress> struct IAsyncActionWithProgress;
+
+template <typename TResult>
+struct IAsyncOperationCompletedHandler : ::IUnknown
+{
+    virtual HRESULT __stdcall abi_Invoke(IAsyncOperation<TResult> * asyncInfo, AsyncStatus status) = 0;
+};
+
+template <typename TResult, typename TProgress>
+struct IAsyncOperationProgressHandler : ::IUnknown
+{
+    virtual HRESULT __stdcall abi_Invoke(IAsyncOperationWithProgress<TResult, TProgress> * asyncInfo, ArgIn<TProgress> progressInfo) = 0;
+};
+
+template <typename TResult, typename TProgress>
+struct IAsyncOperationWithProgressCompletedHandler : ::IUnknown
+{
+    virtual HRESULT __stdcall abi_Invoke(IAsyncOperationWithProgress<TResult, TProgress> * asyncInfo, AsyncStatus status) = 0;
+};
+
+struct IAsyncActionCompletedHandler : ::IUnknown
+{
+    virtual HRESULT __stdcall abi_Invoke(IAsyncAction * asyncInfo, AsyncStatus status) = 0;
+};
+
+template <typename TProgress>
+struct IAsyncActionProgressHandler : ::IUnknown
+{
+    virtual HRESULT __stdcall abi_Invoke(IAsyncActionWithProgress<TProgress> * asyncInfo, ArgIn<TProgress> progressInfo) = 0;
+};
+
+template <typename TProgress>
+struct IAsyncActionWithProgressCompletedHandler : ::IUnknown
+{
+    virtual HRESULT __stdcall abi_Invoke(IAsyncActionWithProgress<TProgress> * asyncInfo, AsyncStatus status) = 0;
+};
+
+template <typename TResult>
+struct IAsyncOperation : ::IInspectable
+{
+    virtual HRESULT __stdcall put_Completed(IAsyncOperationCompletedHandler<TResult> * handler) = 0;
+    virtual HRESULT __stdcall get_Completed(IAsyncOperationCompletedHandler<TResult> ** handler) = 0;
+    virtual HRESULT __stdcall abi_GetResults(ArgOut<TResult> results) = 0;
+};
+
+template <typename TResult, typename TProgress>
+struct IAsyncOperationWithProgress : ::IInspectable
+{
+    virtual HRESULT __stdcall put_Progress(IAsyncOperationProgressHandler<TResult, TProgress> * handler) = 0;
+    virtual HRESULT __stdcall get_Progress(IAsyncOperationProgressHandler<TResult, TProgress> ** handler) = 0;
+    virtual HRESULT __stdcall put_Completed(IAsyncOperationWithProgressCompletedHandler<TResult, TProgress> * handler) = 0;
+    virtual HRESULT __stdcall get_Completed(IAsyncOperationWithProgressCompletedHandler<TResult, TProgress> ** handler) = 0;
+    virtual HRESULT __stdcall abi_GetResults(ArgOut<TResult> results) = 0;
+};
+
+struct IAsyncAction : ::IInspectable
+{
+    virtual HRESULT __stdcall put_Completed(IAsyncActionCompletedHandler * handler) = 0;
+    virtual HRESULT __stdcall get_Completed(IAsyncActionCompletedHandler ** handler) = 0;
+    virtual HRESULT __stdcall abi_GetResults() = 0;
+};
+
+template <typename TProgress>
+struct IAsyncActionWithProgress : ::IInspectable
+{
+    virtual HRESULT __stdcall put_Progress(IAsyncActionProgressHandler<TProgress> * handler) = 0;
+    virtual HRESULT __stdcall get_Progress(IAsyncActionProgressHandler<TProgress> ** handler) = 0;
+    virtual HRESULT __stdcall put_Completed(IAsyncActionWithProgressCompletedHandler<TProgress> * handler) = 0;
+    virtual HRESULT __stdcall get_Completed(IAsyncActionWithProgressCompletedHandler<TProgress> ** handler) = 0;
+    virtual HRESULT __stdcall abi_GetResults() = 0;
+};
+
+}}}
+
+namespace ABI { namespace Windows { namespace Foundation { namespace Collections {
+
+template <typename T>
+struct IIterator : ::IInspectable
+{
+    virtual HRESULT __stdcall get_Current(ArgOut<T> current) = 0;
+    virtual HRESULT __stdcall get_HasCurrent(boolean * hasCurrent) = 0;
+    virtual HRESULT __stdcall abi_MoveNext(boolean * hasCurrent) = 0;
+    virtual HRESULT __stdcall abi_GetMany(unsigned capacity, ArgOut<T> value, unsigned * actual) = 0;
+};
+
+template <typename T>
+struct IIterable : ::IInspectable
+{
+    virtual HRESULT __stdcall abi_First(IIterator<T> ** first) = 0;
+};
+
+template <typename T>
+struct IVectorView : ::IInspectable
+{
+    virtual HRESULT __stdcall abi_GetAt(unsigned index, ArgOut<T> item) = 0;
+    virtual HRESULT __stdcall get_Size(unsigned * size) = 0;
+    virtual HRESULT __stdcall abi_GetMany(unsigned startIndex, unsigned capacity, ArgOut<T> value, unsigned * actual) = 0;
+};
+
+template <typename T>
+struct IVector : ::IInspectable
+{
+    virtual HRESULT __stdcall abi_GetAt(unsigned index, ArgOut<T> item) = 0;
+    virtual HRESULT __stdcall get_Size(unsigned * size) = 0;
+    virtual HRESULT __stdcall abi_GetMany(unsigned startIndex, unsigned capacity, ArgOut<T> value, unsigned * actual) = 0;
+};
+
+// only the VectorChanged event in the SDK - the items are read through IVector
+template <typename T>
+struct IObservableVector : ::IInspectable
+{
+};
+
+}}}}
+
+namespace Windows { struct IUnknown; }
+
+template <>
+struct Traits<Windows::IUnknown>
+{
+    using Abi = ::IUnknown;
+};
+
+namespace Windows {
+
+struct IUnknown
+{
+    IUnknown() noexcept = default;
+    IUnknown(std::nullptr_t) noexcept {}
+
+    IUnknown(IUnknown const & other) noexcept :
+        m_ptr(other.m_ptr)
+    {
+        if (m_ptr)
+        {
+            m_ptr->AddRef();
+        }
+    }
+
+    IUnknown(IUnknown && other) noexcept :
+        m_ptr(other.m_ptr)
+    {
+        other.m_ptr = nullptr;
+    }
+
+    ~IUnknown() noexcept
+    {
+        InternalRelease();
+    }
+
+    IUnknown & operator=(IUnknown const & other) noexcept
+    {
+        if (other.m_ptr)
+        {
+            other.m_ptr->AddRef();
+        }
+        InternalRelease();
+        m_ptr = other.m_ptr;
+        return *this;
+    }
+
+    IUnknown & operator=(IUnknown && other) noexcept
+    {
+        if (this != &other)
+        {
+            InternalRelease();
+            m_ptr = other.m_ptr;
+            other.m_ptr = nullptr;
+        }
+        return *this;
+    }
+
+    IUnknown & operator=(std::nullptr_t) noexcept
+    {
+        InternalRelease();
+        return *this;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return nullptr != m_ptr;
+    }
+
+    template <typename T>
+    T As() const
+    {
+        T temp = nullptr;
+        check(m_ptr->QueryInterface(__uuidof(Abi<T>), reinterpret_cast<void **>(set(temp))));
+        return temp;
+    }
+
+    // the ABI interfaces all derive from ::IUnknown first, so their pointers
+    // are stored as they are
+    template <typename T>
+    friend DefaultAbi<T> * get(T const & object) noexcept
+    {
+        return static_cast<DefaultAbi<T> *>(object.m_ptr);
+    }
+
+    template <typename T>
+    friend DefaultAbi<T> ** set(T & object) noexcept
+    {
+        object.InternalRelease();
+        return reinterpret_cast<DefaultAbi<T> **>(&object.m_ptr);
+    }
+
+    template <typename T>
+    friend void attach(T & object, DefaultAbi<T> * value) noexcept
+    {
+        object.InternalRelease();
+        object.m_ptr = value;
+    }
+
+    template <typename T>
+    friend DefaultAbi<T> * detach(T & object) noexcept
+    {
+        auto temp = get(object);
+        object.m_ptr = nullptr;
+        return temp;
+    }
+
+protected:
+
+    void InternalRelease() noexcept
+    {
+        ::IUnknown * temp = m_ptr;
+        if (temp)
+        {
+            m_ptr = nullptr;
+            temp->Release();
+        }
+    }
+
+    ::IUnknown * m_ptr = nullptr;
+};
+
+inline bool operator==(IUnknown const & left, IUnknown const & right) noexcept
+{
+    return get(left) == get(right);
+}
+
+inline bool operator!=(IUnknown const & left, IUnknown const & right) noexcept
+{
+    return !(left == right);
+}
+
+struct IAsyncInfo;
+
+// the async interfaces require IAsyncInfo, which is queried for on each call
+template <typename T>
+struct impl_IAsyncInfo
+{
+    unsigned Id() const
+    {
+        unsigned id;
+        check(info()->get_Id(&id));
+        return id;
+    }
+
+    AsyncStatus Status() const
+    {
+        AsyncStatus status;
+        check(info()->get_Status(&status));
+        return status;
+    }
+
+    HRESULT ErrorCode() const
+    {
+        HRESULT code;
+        check(info()->get_ErrorCode(&code));
+        return code;
+    }
+
+    void Cancel() const
+    {
+        check(info()->abi_Cancel());
+    }
+
+    void Close() const
+    {
+        check(info()->abi_Close());
+    }
+
+private:
+
+    ComPtr<ABI::Windows::IAsyncInfo> info() const
+    {
+        ComPtr<ABI::Windows::IAsyncInfo> result;
+        check(get(static_cast<T const &>(*this))->QueryInterface(__uuidof(ABI::Windows::IAsyncInfo), reinterpret_cast<void **>(set(result))));
+        return result;
+    }
+};
+
+struct IAsyncInfo :
+    IUnknown,
+    impl_IAsyncInfo<IAsyncInfo>
+{
+    IAsyncInfo(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::IAsyncInfo *>(m_ptr); }
+};
+
+}
+
+template <>
+struct Traits<Windows::IAsyncInfo>
+{
+    using Abi = ABI::Windows::IAsyncInfo;
+};
+
+namespace Windows { namespace Foundation {
+
+// a delegate around a callable, as in modern/base.h
+template <typename HandlerAbi, typename Sender, typename Arg, typename F>
+struct impl_Delegate : Implements<HandlerAbi>
+{
+    explicit impl_Delegate(F handler) : m_handler(std::move(handler))
+    {}
+
+    virtual HRESULT __stdcall abi_Invoke(Abi<Sender> * sender, Arg arg) noexcept override
+    {
+        return call([&]
+        {
+            Sender projected;
+            sender->AddRef();
+            attach(projected, sender);
+            m_handler(projected, arg);
+        });
+    }
+
+private:
+
+    F m_handler;
+};
+
+template <typename HandlerAbi, typename Sender, typename Arg, typename F>
+ComPtr<HandlerAbi> make_delegate(F handler)
+{
+    ComPtr<HandlerAbi> result;
+    attach(result, new impl_Delegate<HandlerAbi, Sender, Arg, F>(std::move(handler)));
+    return result;
+}
+
+template <typename TResult> struct IAsyncOperationCompletedHandler : IUnknown { IAsyncOperationCompletedHandler(std::nullptr_t = nullptr) noexcept {} };
+template <typename TResult, typename TProgress> struct IAsyncOperationProgressHandler : IUnknown { IAsyncOperationProgressHandler(std::nullptr_t = nullptr) noexcept {} };
+template <typename TResult, typename TProgress> struct IAsyncOperationWithProgressCompletedHandler : IUnknown { IAsyncOperationWithProgressCompletedHandler(std::nullptr_t = nullptr) noexcept {} };
+struct IAsyncActionCompletedHandler : IUnknown { IAsyncActionCompletedHandler(std::nullptr_t = nullptr) noexcept {} };
+template <typename TProgress> struct IAsyncActionProgressHandler : IUnknown { IAsyncActionProgressHandler(std::nullptr_t = nullptr) noexcept {} };
+template <typename TProgress> struct IAsyncActionWithProgressCompletedHandler : IUnknown { IAsyncActionWithProgressCompletedHandler(std::nullptr_t = nullptr) noexcept {} };
+
+template <typename TResult>
+struct IAsyncOperation :
+    IUnknown,
+    impl_IAsyncInfo<IAsyncOperation<TResult>>
+{
+    IAsyncOperation(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<Abi<IAsyncOperation> *>(m_ptr); }
+
+    TResult GetResults() const
+    {
+        TResult result = TResult();
+        check((*this)->abi_GetResults(abi(&result)));
+        return result;
+    }
+
+    template <typename F>
+    void Completed(F handler) const
+    {
+        auto delegate = make_delegate<Abi<IAsyncOperationCompletedHandler<TResult>>, IAsyncOperation, AsyncStatus>(std::move(handler));
+        check((*this)->put_Completed(get(delegate)));
+    }
+};
+
+template <typename TResult, typename TProgress>
+struct IAsyncOperationWithProgress :
+    IUnknown,
+    impl_IAsyncInfo<IAsyncOperationWithProgress<TResult, TProgress>>
+{
+    IAsyncOperationWithProgress(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<Abi<IAsyncOperationWithProgress> *>(m_ptr); }
+
+    TResult GetResults() const
+    {
+        TResult result = TResult();
+        check((*this)->abi_GetResults(abi(&result)));
+        return result;
+    }
+
+    template <typename F>
+    void Progress(F handler) const
+    {
+        auto delegate = make_delegate<Abi<IAsyncOperationProgressHandler<TResult, TProgress>>, IAsyncOperationWithProgress, TProgress>(std::move(handler));
+        check((*this)->put_Progress(get(delegate)));
+    }
+
+    template <typename F>
+    void Completed(F handler) const
+    {
+        auto delegate = make_delegate<Abi<IAsyncOperationWithProgressCompletedHandler<TResult, TProgress>>, IAsyncOperationWithProgress, AsyncStatus>(std::move(handler));
+        check((*this)->put_Completed(get(delegate)));
+    }
+};
+
+struct IAsyncAction :
+    IUnknown,
+    impl_IAsyncInfo<IAsyncAction>
+{
+    IAsyncAction(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::Foundation::IAsyncAction *>(m_ptr); }
+
+    void GetResults() const
+    {
+        check((*this)->abi_GetResults());
+    }
+};
+
+template <typename TProgress>
+struct IAsyncActionWithProgress :
+    IUnknown,
+    impl_IAsyncInfo<IAsyncActionWithProgress<TProgress>>
+{
+    IAsyncActionWithProgress(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<Abi<IAsyncActionWithProgress> *>(m_ptr); }
+
+    void GetResults() const
+    {
+        check((*this)->abi_GetResults());
+    }
+};
+
+}}
+
+template <typename TResult> struct Traits<Windows::Foundation::IAsyncOperationCompletedHandler<TResult>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncOperationCompletedHandler<typename Traits<TResult>::Abi>;
+};
+
+template <typename TResult, typename TProgress> struct Traits<Windows::Foundation::IAsyncOperationProgressHandler<TResult, TProgress>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncOperationProgressHandler<typename Traits<TResult>::Abi, typename Traits<TProgress>::Abi>;
+};
+
+template <typename TResult, typename TProgress> struct Traits<Windows::Foundation::IAsyncOperationWithProgressCompletedHandler<TResult, TProgress>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncOperationWithProgressCompletedHandler<typename Traits<TResult>::Abi, typename Traits<TProgress>::Abi>;
+};
+
+template <> struct Traits<Windows::Foundation::IAsyncActionCompletedHandler>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncActionCompletedHandler;
+};
+
+template <typename TProgress> struct Traits<Windows::Foundation::IAsyncActionProgressHandler<TProgress>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncActionProgressHandler<typename Traits<TProgress>::Abi>;
+};
+
+template <typename TProgress> struct Traits<Windows::Foundation::IAsyncActionWithProgressCompletedHandler<TProgress>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncActionWithProgressCompletedHandler<typename Traits<TProgress>::Abi>;
+};
+
+template <typename TResult> struct Traits<Windows::Foundation::IAsyncOperation<TResult>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncOperation<typename Traits<TResult>::Abi>;
+};
+
+template <typename TResult, typename TProgress> struct Traits<Windows::Foundation::IAsyncOperationWithProgress<TResult, TProgress>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncOperationWithProgress<typename Traits<TResult>::Abi, typename Traits<TProgress>::Abi>;
+};
+
+template <> struct Traits<Windows::Foundation::IAsyncAction>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncAction;
+};
+
+template <typename TProgress> struct Traits<Windows::Foundation::IAsyncActionWithProgress<TProgress>>
+{
+    using Abi = ABI::Windows::Foundation::IAsyncActionWithProgress<typename Traits<TProgress>::Abi>;
+};
+
+namespace Windows { namespace Foundation { namespace Collections {
+
+template <typename T>
+class FastIterator
+{
+    T const * m_collection = nullptr;
+    unsigned m_index = 0;
+
+public:
+
+    typedef std::input_iterator_tag iterator_category;
+    typedef decltype(std::declval<T>().GetAt(0)) value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef value_type * pointer;
+    typedef value_type reference;
+
+    FastIterator(T const & collection, unsigned const index) noexcept :
+        m_collection(&collection),
+        m_index(index)
+    {}
+
+    FastIterator & operator++() noexcept
+    {
+        ++m_index;
+        return *this;
+    }
+
+    value_type operator *() const
+    {
+        return m_collection->GetAt(m_index);
+    }
+
+    bool operator==(FastIterator const & other) const noexcept
+    {
+        return m_index == other.m_index;
+    }
+
+    bool operator!=(FastIterator const & other) const noexcept
+    {
+        return !(*this == other);
+    }
+};
+
+template <typename T>
+struct IIterator :
+    IUnknown
+{
+    IIterator(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::Foundation::Collections::IIterator<Abi<T>> *>(m_ptr); }
+
+    T Current() const
+    {
+        T result = T();
+        check((*this)->get_Current(abi(&result)));
+        return result;
+    }
+
+    bool HasCurrent() const
+    {
+        boolean result = 0;
+        check((*this)->get_HasCurrent(&result));
+        return 0 != result;
+    }
+
+    bool MoveNext() const
+    {
+        boolean result = 0;
+        check((*this)->abi_MoveNext(&result));
+        return 0 != result;
+    }
+};
+
+// range-for over an IIterable - the end iterator has no IIterator
+template <typename T>
+class IteratorAdapter
+{
+    IIterator<T> m_iterator;
+
+public:
+
+    explicit IteratorAdapter(IIterator<T> iterator = nullptr) :
+        m_iterator(std::move(iterator))
+    {
+        if (m_iterator && !m_iterator.HasCurrent())
+        {
+            m_iterator = nullptr;
+        }
+    }
+
+    IteratorAdapter & operator++()
+    {
+        if (!m_iterator.MoveNext())
+        {
+            m_iterator = nullptr;
+        }
+        return *this;
+    }
+
+    T operator *() const
+    {
+        return m_iterator.Current();
+    }
+
+    bool operator!=(IteratorAdapter const & other) const noexcept
+    {
+        return static_cast<bool>(m_iterator) != static_cast<bool>(other.m_iterator);
+    }
+};
+
+template <typename T>
+struct IIterable :
+    IUnknown
+{
+    IIterable(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::Foundation::Collections::IIterable<Abi<T>> *>(m_ptr); }
+
+    IIterator<T> First() const
+    {
+        IIterator<T> result;
+        check((*this)->abi_First(set(result)));
+        return result;
+    }
+
+    IteratorAdapter<T> begin() const
+    {
+        return IteratorAdapter<T>(First());
+    }
+
+    IteratorAdapter<T> end() const
+    {
+        return IteratorAdapter<T>();
+    }
+};
+
+template <typename D, typename T>
+struct impl_IVectorView
+{
+    T GetAt(unsigned const index) const
+    {
+        T result = T();
+        check(static_cast<D const &>(*this)->abi_GetAt(index, abi(&result)));
+        return result;
+    }
+
+    unsigned Size() const
+    {
+        unsigned size = 0;
+        check(static_cast<D const &>(*this)->get_Size(&size));
+        return size;
+    }
+
+    IIterator<T> First() const
+    {
+        return static_cast<D const &>(*this).template As<IIterable<T>>().First();
+    }
+
+    FastIterator<D> begin() const
+    {
+        return FastIterator<D>(static_cast<D const &>(*this), 0);
+    }
+
+    FastIterator<D> end() const
+    {
+        return FastIterator<D>(static_cast<D const &>(*this), Size());
+    }
+};
+
+template <typename T>
+struct IVectorView :
+    IUnknown,
+    impl_IVectorView<IVectorView<T>, T>
+{
+    IVectorView(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::Foundation::Collections::IVectorView<Abi<T>> *>(m_ptr); }
+};
+
+template <typename T>
+struct IVector :
+    IUnknown,
+    impl_IVectorView<IVector<T>, T>
+{
+    IVector(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::Foundation::Collections::IVector<Abi<T>> *>(m_ptr); }
+};
+
+// the IVector methods come from the IVector it requires
+template <typename T>
+struct IObservableVector :
+    IUnknown
+{
+    IObservableVector(std::nullptr_t = nullptr) noexcept {}
+    auto operator->() const noexcept { return static_cast<ABI::Windows::Foundation::Collections::IObservableVector<Abi<T>> *>(m_ptr); }
+
+    operator IVector<T>() const
+    {
+        return As<IVector<T>>();
+    }
+
+    T GetAt(unsigned const index) const
+    {
+        return As<IVector<T>>().GetAt(index);
+    }
+
+    unsigned Size() const
+    {
+        return As<IVector<T>>().Size();
+    }
+
+    IIterator<T> First() const
+    {
+        return As<IIterable<T>>().First();
+    }
+
+    FastIterator<IObservableVector> begin() const
+    {
+        return FastIterator<IObservableVector>(*this, 0);
+    }
+
+    FastIterator<IObservableVector> end() const
+    {
+        return FastIterator<IObservableVector>(*this, Size());
+    }
+};
+
+}}}
+
+template <typename T> struct Traits<Windows::Foundation::Collections::IIterator<T>>
+{
+    using Abi = ABI::Windows::Foundation::Collections::IIterator<typename Traits<T>::Abi>;
+};
+
+template <typename T> struct Traits<Windows::Foundation::Collections::IIterable<T>>
+{
+    using Abi = ABI::Windows::Foundation::Collections::IIterable<typename Traits<T>::Abi>;
+};
+
+template <typename T> struct Traits<Windows::Foundation::Collections::IVectorView<T>>
+{
+    using Abi = ABI::Windows::Foundation::Collections::IVectorView<typename Traits<T>::Abi>;
+};
+
+template <typename T> struct Traits<Windows::Foundation::Collections::IVector<T>>
+{
+    using Abi = ABI::Windows::Foundation::Collections::IVector<typename Traits<T>::Abi>;
+};
+
+template <typename T> struct Traits<Windows::Foundation::Collections::IObservableVector<T>>
+{
+    using Abi = ABI::Windows::Foundation::Collections::IObservableVector<typename Traits<T>::Abi>;
+};
+
+template <typename T, typename Enable = void>
+struct Argument
+{
+    static constexpr T Empty() noexcept
+    {
+        return {};
+    }
+};
+
+template <typename T>
+struct Argument<T, typename std::enable_if<std::is_base_of<Windows::IUnknown, T>::value>::type>
+{
+    static T Empty() noexcept
+    {
+        return nullptr;
+    }
+};
+
+template <typename T>
+using AbiArgIn = typename ABI::ArgIn<DefaultAbi<T>>;
+
+template <typename T>
+using AbiArgOut = typename ABI::ArgOut<DefaultAbi<T>>;
+
+}
@@ -0,0 +1,1052 @@
+#pragma once
+
+// a stand-in for the parts of rxcpp that the rx.modern headers use, so that
+// they build and run on linux. the semantics follow rxcpp - a subscriber
+// stops delivering once it is unsubscribed, on_error and on_completed
+// unsubscribe it, and adding to an unsubscribed lifetime ends the addition
+// at once.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rxcpp {
+
+    namespace detail {
+
+        struct subscription_state
+        {
+            subscription_state()
+                : subscribed(true)
+            {
+            }
+
+            std::mutex lock;
+            bool subscribed;
+            std::function<void()> teardown;
+            std::vector<std::shared_ptr<subscription_state>> inner;
+        };
+    }
+
+    typedef std::weak_ptr<detail::subscription_state> weak_subscription;
+
+    class composite_subscription
+    {
+        std::shared_ptr<detail::subscription_state> state;
+
+    public:
+        composite_subscription()
+            : state(std::make_shared<detail::subscription_state>())
+        {
+        }
+
+        bool is_subscribed() const {
+            std::unique_lock<std::mutex> guard(state->lock);
+            return state->subscribed;
+        }
+
+        weak_subscription add(composite_subscription s) const {
+            if (s.state == state) {
+                return weak_subscription();
+            }
+            {
+                std::unique_lock<std::mutex> guard(state->lock);
+                if (state->subscribed) {
+                    state->inner.push_back(s.state);
+                    return s.state;
+                }
+            }
+            s.unsubscribe();
+            return weak_subscription();
+        }
+
+        template<class F, class = decltype(std::declval<F&>()())>
+        weak_subscription add(F f) const {
+            composite_subscription s;
+            s.state->teardown = std::move(f);
+            return add(std::move(s));
+        }
+
+        void remove(weak_subscription w) const {
+            auto s = w.lock();
+            if (!s) {
+                return;
+            }
+            std::shared_ptr<detail::subscription_state> removed;
+            std::unique_lock<std::mutex> guard(state->lock);
+            for (auto it = state->inner.begin(); it != state->inner.end(); ++it) {
+                if (*it == s) {
+                    // released outside the lock
+                    removed = std::move(*it);
+                    state->inner.erase(it);
+                    break;
+                }
+            }
+            guard.unlock();
+        }
+
+        void unsubscribe() const {
+            std::vector<std::shared_ptr<detail::subscription_state>> inner;
+            std::function<void()> teardown;
+            {
+                std::unique_lock<std::mutex> guard(state->lock);
+                if (!state->subscribed) {
+                    return;
+                }
+                state->subscribed = false;
+                swap(inner, state->inner);
+                swap(teardown, state->teardown);
+            }
+            for (auto& s : inner) {
+                composite_subscription c;
+                c.state = s;
+                c.unsubscribe();
+            }
+            if (teardown) {
+                teardown();
+            }
+        }
+
+        friend bool operator==(const composite_subscription& l, const composite_subscription& r) {
+            return l.state == r.state;
+        }
+        friend bool operator!=(const composite_subscription& l, const composite_subscription& r) {
+            return !(l == r);
+        }
+    };
+
+    template<class T>
+    struct observer_interface
+    {
+        virtual ~observer_interface() {}
+        virtual void on_next(const T&) const = 0;
+        virtual void on_error(std::exception_ptr) const = 0;
+        virtual void on_completed() const = 0;
+    };
+
+    namespace detail {
+
+        struct terminate_on_error
+        {
+            void operator()(std::exception_ptr) const {
+                // rxcpp aborts on an error nobody handles
+                std::terminate();
+            }
+        };
+
+        struct ignore_completed
+        {
+            void operator()() const {
+            }
+        };
+
+        template<class T, class OnNext, class OnError, class OnCompleted>
+        struct lambda_observer : public observer_interface<T>
+        {
+            lambda_observer(OnNext n, OnError e, OnCompleted c)
+                : n(std::move(n))
+                , e(std::move(e))
+                , c(std::move(c))
+            {
+            }
+
+            virtual void on_next(const T& t) const {
+                n(t);
+            }
+            virtual void on_error(std::exception_ptr ep) const {
+                e(ep);
+            }
+            virtual void on_completed() const {
+                c();
+            }
+
+            OnNext n;
+            OnError e;
+            OnCompleted c;
+        };
+    }
+
+    template<class T>
+    class subscriber
+    {
+        composite_subscription lifetime;
+        std::shared_ptr<const observer_interface<T>> destination;
+
+    public:
+        typedef T value_type;
+
+        subscriber(composite_subscription cs, std::shared_ptr<const observer_interface<T>> d)
+            : lifetime(std::move(cs))
+            , destination(std::move(d))
+        {
+        }
+
+        const composite_subscription& get_subscription() const {
+            return lifetime;
+        }
+        composite_subscription& get_subscription() {
+            return lifetime;
+        }
+
+        bool is_subscribed() const {
+            return lifetime.is_subscribed();
+        }
+
+        template<class A>
+        weak_subscription add(A&& a) const {
+            return lifetime.add(std::forward<A>(a));
+        }
+
+        void remove(weak_subscription w) const {
+            lifetime.remove(w);
+        }
+
+        void unsubscribe() const {
+            lifetime.unsubscribe();
+        }
+
+        subscriber as_dynamic() const {
+            return *this;
+        }
+
+        void on_next(const T& t) const {
+            if (!is_subscribed()) {
+                return;
+            }
+            destination->on_next(t);
+        }
+
+        void on_error(std::exception_ptr e) const {
+            if (!is_subscribed()) {
+                return;
+            }
+            destination->on_error(e);
+            lifetime.unsubscribe();
+        }
+
+        void on_completed() const {
+            if (!is_subscribed()) {
+                return;
+            }
+            destination->on_completed();
+            lifetime.unsubscribe();
+        }
+    };
+
+    template<class T, class OnNext, class OnError = detail::terminate_on_error, class OnCompleted = detail::ignore_completed>
+    subscriber<T> make_subscriber(composite_subscription cs, OnNext n, OnError e = OnError(), OnCompleted c = OnCompleted()) {
+        typedef detail::lambda_observer<T, OnNext, OnError, OnCompleted> observer_type;
+        return subscriber<T>(std::move(cs), std::make_shared<observer_type>(std::move(n), std::move(e), std::move(c)));
+    }
+
+    namespace util {
+
+        template<class T>
+        class maybe
+        {
+            bool is_set;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+            T* slot() {
+                return reinterpret_cast<T*>(&storage);
+            }
+            const T* slot() const {
+                return reinterpret_cast<const T*>(&storage);
+            }
+
+        public:
+            maybe()
+                : is_set(false)
+            {
+            }
+            explicit maybe(T value)
+                : is_set(false)
+            {
+                reset(std::move(value));
+            }
+            maybe(const maybe& other)
+                : is_set(false)
+            {
+                if (other.is_set) {
+                    reset(other.get());
+                }
+            }
+            maybe(maybe&& other)
+                : is_set(false)
+            {
+                if (other.is_set) {
+                    reset(std::move(other.get()));
+                }
+            }
+            ~maybe()
+            {
+                reset();
+            }
+
+            maybe& operator=(maybe other) {
+                reset();
+                if (other.is_set) {
+                    reset(std::move(other.get()));
+                }
+                return *this;
+            }
+
+            bool empty() const {
+                return !is_set;
+            }
+
+            T& get() {
+                return *slot();
+            }
+            const T& get() const {
+                return *slot();
+            }
+
+            void reset() {
+                if (is_set) {
+                    slot()->~T();
+                    is_set = false;
+                }
+            }
+
+            template<class U>
+            void reset(U&& value) {
+                reset();
+                new (&storage) T(std::forward<U>(value));
+                is_set = true;
+            }
+        };
+    }
+    using util::maybe;
+
+    namespace sources {
+
+        template<class T>
+        struct source_base
+        {
+            typedef T value_type;
+        };
+    }
+
+    template<class T = void, class SourceOperator = void>
+    class observable;
+
+    namespace detail {
+
+        template<class T>
+        struct dynamic_source : public sources::source_base<T>
+        {
+            typedef std::function<void(subscriber<T>)> on_subscribe_type;
+
+            dynamic_source()
+            {
+            }
+            explicit dynamic_source(on_subscribe_type f)
+                : f(std::make_shared<on_subscribe_type>(std::move(f)))
+            {
+            }
+
+            void on_subscribe(subscriber<T> o) const {
+                (*f)(std::move(o));
+            }
+
+            std::shared_ptr<const on_subscribe_type> f;
+        };
+
+        template<class T, class SourceOperator>
+        struct source_of
+        {
+            typedef SourceOperator type;
+        };
+
+        template<class T>
+        struct source_of<T, void>
+        {
+            typedef dynamic_source<T> type;
+        };
+
+        template<class T>
+        struct is_subscriber : std::false_type
+        {
+        };
+
+        template<class T>
+        struct is_subscriber<subscriber<T>> : std::true_type
+        {
+        };
+    }
+
+    template<class T>
+    class connectable_observable;
+
+    template<class T, class SourceOperator>
+    class observable
+    {
+        typedef typename detail::source_of<T, SourceOperator>::type source_type;
+        source_type source;
+
+    public:
+        typedef T value_type;
+
+        observable()
+        {
+        }
+        explicit observable(source_type s)
+            : source(std::move(s))
+        {
+        }
+        // any observable converts to the type-erased observable<T>
+        template<class S, class V = SourceOperator, class = typename std::enable_if<std::is_void<V>::value>::type>
+        observable(const observable<T, S>& o)
+            : source(o.as_dynamic().source)
+        {
+        }
+
+        observable<T> as_dynamic() const {
+            auto s = source;
+            return observable<T>(detail::dynamic_source<T>([s](subscriber<T> o) {
+                s.on_subscribe(std::move(o));
+            }));
+        }
+
+        composite_subscription subscribe(subscriber<T> o) const {
+            if (o.is_subscribed()) {
+                try {
+                    source.on_subscribe(o);
+                }
+                catch (...) {
+                    o.on_error(std::current_exception());
+                }
+            }
+            return o.get_subscription();
+        }
+
+        template<class... ArgN>
+        composite_subscription subscribe(composite_subscription cs, ArgN&&... an) const {
+            return subscribe(make_subscriber<T>(std::move(cs), std::forward<ArgN>(an)...));
+        }
+
+        template<class OnNext, class... ArgN, class = typename std::enable_if<
+            !std::is_same<typename std::decay<OnNext>::type, composite_subscription>::value &&
+            !detail::is_subscriber<typename std::decay<OnNext>::type>::value>::type>
+        composite_subscription subscribe(OnNext&& n, ArgN&&... an) const {
+            return subscribe(composite_subscription(), std::forward<OnNext>(n), std::forward<ArgN>(an)...);
+        }
+
+        template<class Selector>
+        auto map(Selector s) const -> observable<typename std::decay<decltype(s(std::declval<const T&>()))>::type> {
+            typedef typename std::decay<decltype(s(std::declval<const T&>()))>::type result_type;
+            auto self = *this;
+            return observable<result_type>(detail::dynamic_source<result_type>([self, s](subscriber<result_type> o) {
+                self.subscribe(
+                    o.get_subscription(),
+                    [o, s](const T& t) {
+                        o.on_next(s(t));
+                    },
+                    [o](std::exception_ptr e) {
+                        o.on_error(e);
+                    },
+                    [o]() {
+                        o.on_completed();
+                    });
+            }));
+        }
+
+        template<class Predicate>
+        observable<T> filter(Predicate p) const {
+            auto self = *this;
+            return observable<T>(detail::dynamic_source<T>([self, p](subscriber<T> o) {
+                self.subscribe(
+                    o.get_subscription(),
+                    [o, p](const T& t) {
+                        if (p(t)) {
+                            o.on_next(t);
+                        }
+                    },
+                    [o](std::exception_ptr e) {
+                        o.on_error(e);
+                    },
+                    [o]() {
+                        o.on_completed();
+                    });
+            }));
+        }
+
+        observable<T> start_with(T first) const {
+            auto self = *this;
+            return observable<T>(detail::dynamic_source<T>([self, first](subscriber<T> o) {
+                o.on_next(first);
+                self.subscribe(o);
+            }));
+        }
+
+        template<class Coordination>
+        observable<T> observe_on(Coordination cn) const;
+
+        // the source shared through a subject, subscribed on connect
+        connectable_observable<T> publish() const;
+
+        template<class OperatorFactory>
+        auto op(OperatorFactory&& of) const -> decltype(of(*this)) {
+            return of(*this);
+        }
+
+        template<class, class>
+        friend class observable;
+    };
+
+    template<class T, class SourceOperator, class OperatorFactory>
+    auto operator|(const observable<T, SourceOperator>& source, OperatorFactory&& of) -> decltype(source.op(std::forward<OperatorFactory>(of))) {
+        return source.op(std::forward<OperatorFactory>(of));
+    }
+
+    namespace sources {
+
+        // on_subscribe gets an lvalue, as in rxcpp
+        template<class T, class OnSubscribe>
+        observable<T> create(OnSubscribe os) {
+            return observable<T>(detail::dynamic_source<T>([os](subscriber<T> o) {
+                os(o);
+            }));
+        }
+
+        template<class ObservableFactory>
+        auto defer(ObservableFactory of) -> observable<typename decltype(of())::value_type> {
+            typedef typename decltype(of())::value_type value_type;
+            return create<value_type>([of](subscriber<value_type> o) {
+                of().subscribe(o);
+            });
+        }
+    }
+
+    template<>
+    class observable<void, void>
+    {
+    public:
+        template<class T>
+        static observable<T> never() {
+            return sources::create<T>([](subscriber<T>) {});
+        }
+
+        template<class T>
+        static observable<T> empty() {
+            return sources::create<T>([](subscriber<T> o) {
+                o.on_completed();
+            });
+        }
+
+        template<class T>
+        static observable<T> just(T value) {
+            return sources::create<T>([value](subscriber<T> o) {
+                o.on_next(value);
+                o.on_completed();
+            });
+        }
+
+        template<class T>
+        static observable<T> error(std::exception_ptr e) {
+            return sources::create<T>([e](subscriber<T> o) {
+                o.on_error(e);
+            });
+        }
+    };
+
+    namespace subjects {
+
+        // multicasts to the subscribers of get_observable(). a subscriber that
+        // arrives after the end gets only the terminal notification.
+        template<class T>
+        class subject
+        {
+            struct state_type
+            {
+                state_type()
+                    : done(false)
+                {
+                }
+
+                std::mutex lock;
+                std::vector<subscriber<T>> observers;
+                bool done;
+                std::exception_ptr error;
+            };
+
+            std::shared_ptr<state_type> state;
+
+            std::vector<subscriber<T>> snapshot(bool finish, std::exception_ptr e) const {
+                std::unique_lock<std::mutex> guard(state->lock);
+                if (state->done) {
+                    return std::vector<subscriber<T>>();
+                }
+                auto observers = state->observers;
+                if (finish) {
+                    state->done = true;
+                    state->error = e;
+                    state->observers.clear();
+                }
+                return observers;
+            }
+
+        public:
+            subject()
+                : state(std::make_shared<state_type>())
+            {
+            }
+
+            bool has_observers() const {
+                std::unique_lock<std::mutex> guard(state->lock);
+                for (auto& o : state->observers) {
+                    if (o.is_subscribed()) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            subscriber<T> get_subscriber() const {
+                auto that = *this;
+                return make_subscriber<T>(
+                    composite_subscription(),
+                    [that](const T& t) {
+                        for (auto& o : that.snapshot(false, nullptr)) {
+                            o.on_next(t);
+                        }
+                    },
+                    [that](std::exception_ptr e) {
+                        for (auto& o : that.snapshot(true, e)) {
+                            o.on_error(e);
+                        }
+                    },
+                    [that]() {
+                        for (auto& o : that.snapshot(true, nullptr)) {
+                            o.on_completed();
+                        }
+                    });
+            }
+
+            observable<T> get_observable() const {
+                auto s = state;
+                return sources::create<T>([s](subscriber<T> o) {
+                    std::unique_lock<std::mutex> guard(s->lock);
+                    if (!s->done) {
+                        s->observers.push_back(o);
+                        return;
+                    }
+                    auto e = s->error;
+                    guard.unlock();
+                    if (e) {
+                        o.on_error(e);
+                    }
+                    else {
+                        o.on_completed();
+                    }
+                });
+            }
+        };
+    }
+
+    template<class T>
+    class connectable_observable
+    {
+        struct state_type
+        {
+            explicit state_type(observable<T> source)
+                : source(std::move(source))
+                , count(0)
+            {
+                // not connected
+                connection.unsubscribe();
+            }
+
+            std::mutex lock;
+            subjects::subject<T> subject;
+            observable<T> source;
+            composite_subscription connection;
+            int count;
+        };
+
+        std::shared_ptr<state_type> state;
+
+    public:
+        typedef T value_type;
+
+        explicit connectable_observable(observable<T> source)
+            : state(std::make_shared<state_type>(std::move(source)))
+        {
+        }
+
+        composite_subscription connect() const {
+            composite_subscription connection;
+            {
+                std::unique_lock<std::mutex> guard(state->lock);
+                if (state->connection.is_subscribed()) {
+                    return state->connection;
+                }
+                state->connection = connection;
+            }
+            auto sink = state->subject.get_subscriber();
+            state->source.subscribe(
+                connection,
+                [sink](const T& t) {
+                    sink.on_next(t);
+                },
+                [sink](std::exception_ptr e) {
+                    sink.on_error(e);
+                },
+                [sink]() {
+                    sink.on_completed();
+                });
+            return connection;
+        }
+
+        // connects on the first subscriber and disconnects after the last
+        observable<T> ref_count() const {
+            auto self = *this;
+            return sources::create<T>([self](subscriber<T> o) {
+                auto s = self.state;
+                o.add([s]() {
+                    composite_subscription connection;
+                    {
+                        std::unique_lock<std::mutex> guard(s->lock);
+                        if (--s->count != 0) {
+                            return;
+                        }
+                        connection = s->connection;
+                    }
+                    connection.unsubscribe();
+                });
+                bool first;
+                {
+                    std::unique_lock<std::mutex> guard(s->lock);
+                    first = ++s->count == 1;
+                }
+                s->subject.get_observable().subscribe(o);
+                if (first) {
+                    self.connect();
+                }
+            });
+        }
+    };
+
+    template<class T, class SourceOperator>
+    connectable_observable<T> observable<T, SourceOperator>::publish() const {
+        return connectable_observable<T>(as_dynamic());
+    }
+
+    namespace schedulers {
+
+        class worker;
+        class schedulable;
+
+        struct scheduler_base
+        {
+            typedef std::chrono::steady_clock clock_type;
+        };
+
+        class recurse
+        {
+            bool allowed;
+
+        public:
+            explicit recurse(bool allowed)
+                : allowed(allowed)
+            {
+            }
+
+            bool is_allowed() const {
+                return allowed;
+            }
+        };
+
+        class recursion
+        {
+            recurse r;
+
+        public:
+            explicit recursion(bool allowed = true)
+                : r(allowed)
+            {
+            }
+
+            const recurse& get_recurse() const {
+                return r;
+            }
+        };
+
+        struct worker_interface : public scheduler_base, public std::enable_shared_from_this<worker_interface>
+        {
+            virtual ~worker_interface() {}
+            virtual clock_type::time_point now() const = 0;
+            virtual void schedule(const schedulable& scbl) const = 0;
+            virtual void schedule(clock_type::time_point when, const schedulable& scbl) const = 0;
+        };
+
+        struct scheduler_interface : public scheduler_base, public std::enable_shared_from_this<scheduler_interface>
+        {
+            virtual ~scheduler_interface() {}
+            virtual clock_type::time_point now() const = 0;
+            virtual worker create_worker(composite_subscription cs) const = 0;
+        };
+
+        class worker : public scheduler_base
+        {
+            composite_subscription lifetime;
+            std::shared_ptr<const worker_interface> inner;
+
+        public:
+            worker()
+            {
+            }
+            worker(composite_subscription cs, std::shared_ptr<const worker_interface> i)
+                : lifetime(std::move(cs))
+                , inner(std::move(i))
+            {
+            }
+
+            const composite_subscription& get_subscription() const {
+                return lifetime;
+            }
+            bool is_subscribed() const {
+                return lifetime.is_subscribed();
+            }
+            template<class A>
+            weak_subscription add(A&& a) const {
+                return lifetime.add(std::forward<A>(a));
+            }
+            void remove(weak_subscription w) const {
+                lifetime.remove(w);
+            }
+            void unsubscribe() const {
+                lifetime.unsubscribe();
+            }
+
+            clock_type::time_point now() const {
+                return inner->now();
+            }
+
+            void schedule(const schedulable& scbl) const;
+            void schedule(clock_type::time_point when, const schedulable& scbl) const;
+        };
+
+        class schedulable : public scheduler_base
+        {
+            typedef std::function<void(const schedulable&)> action_type;
+
+            composite_subscription lifetime;
+            worker controller;
+            std::shared_ptr<const action_type> activity;
+
+        public:
+            // the action and the worker share a lifetime
+            schedulable(worker w, action_type a)
+                : lifetime(w.get_subscription())
+                , controller(std::move(w))
+                , activity(std::make_shared<action_type>(std::move(a)))
+            {
+            }
+            schedulable(composite_subscription cs, worker w, action_type a)
+                : lifetime(std::move(cs))
+                , controller(std::move(w))
+                , activity(std::make_shared<action_type>(std::move(a)))
+            {
+            }
+
+            const composite_subscription& get_subscription() const {
+                return lifetime;
+            }
+            bool is_subscribed() const {
+                return lifetime.is_subscribed();
+            }
+            template<class A>
+            weak_subscription add(A&& a) const {
+                return lifetime.add(std::forward<A>(a));
+            }
+            void remove(weak_subscription w) const {
+                lifetime.remove(w);
+            }
+            void unsubscribe() const {
+                lifetime.unsubscribe();
+            }
+
+            const worker& get_worker() const {
+                return controller;
+            }
+
+            void schedule() const {
+                controller.schedule(*this);
+            }
+            void schedule(clock_type::time_point when) const {
+                controller.schedule(when, *this);
+            }
+
+            void operator()(const recurse&) const {
+                if (!is_subscribed()) {
+                    return;
+                }
+                (*activity)(*this);
+            }
+        };
+
+        inline void worker::schedule(const schedulable& scbl) const {
+            if (scbl.is_subscribed()) {
+                inner->schedule(scbl);
+            }
+        }
+
+        inline void worker::schedule(clock_type::time_point when, const schedulable& scbl) const {
+            if (scbl.is_subscribed()) {
+                inner->schedule(when, scbl);
+            }
+        }
+
+        template<class F>
+        schedulable make_schedulable(const worker& w, F f) {
+            return schedulable(w, std::move(f));
+        }
+
+        template<class F>
+        schedulable make_schedulable(const worker& w, composite_subscription cs, F f) {
+            return schedulable(std::move(cs), w, std::move(f));
+        }
+
+        class scheduler : public scheduler_base
+        {
+            std::shared_ptr<const scheduler_interface> inner;
+
+        public:
+            scheduler()
+            {
+            }
+            explicit scheduler(std::shared_ptr<const scheduler_interface> i)
+                : inner(std::move(i))
+            {
+            }
+
+            clock_type::time_point now() const {
+                return inner->now();
+            }
+
+            worker create_worker(composite_subscription cs = composite_subscription()) const {
+                return inner->create_worker(std::move(cs));
+            }
+        };
+
+        template<class Scheduler, class... ArgN>
+        scheduler make_scheduler(ArgN&&... an) {
+            return scheduler(std::make_shared<Scheduler>(std::forward<ArgN>(an)...));
+        }
+    }
+
+    using schedulers::scheduler;
+    using schedulers::worker;
+    using schedulers::schedulable;
+
+    struct tag_coordination
+    {
+    };
+
+    struct coordination_base
+    {
+        typedef tag_coordination coordination_tag;
+    };
+
+    template<class T, class = void>
+    struct is_coordination : std::false_type
+    {
+    };
+
+    template<class T>
+    struct is_coordination<T, typename std::enable_if<std::is_same<typename std::decay<T>::type::coordination_tag, tag_coordination>::value>::type> : std::true_type
+    {
+    };
+
+    class coordinator
+    {
+        schedulers::worker w;
+
+    public:
+        explicit coordinator(schedulers::worker w)
+            : w(std::move(w))
+        {
+        }
+
+        schedulers::worker get_worker() const {
+            return w;
+        }
+    };
+
+    class identity_one_worker : public coordination_base
+    {
+        schedulers::scheduler factory;
+
+    public:
+        typedef coordinator coordinator_type;
+
+        explicit identity_one_worker(schedulers::scheduler sc)
+            : factory(std::move(sc))
+        {
+        }
+
+        schedulers::scheduler::clock_type::time_point now() const {
+            return factory.now();
+        }
+
+        coordinator_type create_coordinator(composite_subscription cs = composite_subscription()) const {
+            return coordinator_type(factory.create_worker(std::move(cs)));
+        }
+    };
+
+    // the stand-in does not serialize the coordinated observables - the
+    // workers handed out are serial already
+    class serialize_one_worker : public identity_one_worker
+    {
+    public:
+        explicit serialize_one_worker(schedulers::scheduler sc)
+            : identity_one_worker(std::move(sc))
+        {
+        }
+    };
+
+    // each notification is scheduled on one worker, which keeps them in order
+    template<class T, class SourceOperator>
+    template<class Coordination>
+    observable<T> observable<T, SourceOperator>::observe_on(Coordination cn) const {
+        auto self = *this;
+        return sources::create<T>([self, cn](subscriber<T> o) {
+            auto w = cn.create_coordinator(o.get_subscription()).get_worker();
+            composite_subscription lifetime;
+            o.add(lifetime);
+            self.subscribe(
+                lifetime,
+                [o, w](const T& t) {
+                    w.schedule(schedulers::make_schedulable(w, [o, t](const schedulable&) {
+                        o.on_next(t);
+                    }));
+                },
+                [o, w](std::exception_ptr e) {
+                    w.schedule(schedulers::make_schedulable(w, [o, e](const schedulable&) {
+                        o.on_error(e);
+                    }));
+                },
+                [o, w]() {
+                    w.schedule(schedulers::make_schedulable(w, [o](const schedulable&) {
+                        o.on_completed();
+                    }));
+                });
+        });
+    }
+
+    namespace operators {
+    }
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+// a linux stand-in for rx.modern.schedulers.h, which is built on the WinRT
+// thread pool and CoreDispatcher. the thread pool is the work-stealing pool
+// and the dispatcher is one thread with a queue, standing in for the thread
+// of the current window. core_dispatcher drains through the same
+// dispatcher_queue as the real one, posting to that thread.
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Rx {
+
+    inline std::shared_ptr<timer_wheel> shared_timer_wheel() {
+        return shared_thread_timer_wheel();
+    }
+
+    inline std::shared_ptr<timer_wheel> shared_precise_timer_wheel() {
+        return shared_thread_timer_wheel();
+    }
+
+    enum class timer_precision
+    {
+        standard,
+        precise
+    };
+
+    inline scheduler make_thread_pool(timer_precision = timer_precision::standard) {
+        return make_work_stealing_pool();
+    }
+
+    inline serialize_one_worker serialize_thread_pool(timer_precision = timer_precision::standard) {
+        serialize_one_worker r(make_thread_pool());
+        return r;
+    }
+
+    namespace detail {
+
+        struct dispatcher_state
+        {
+            dispatcher_state()
+                : posted(0)
+                , stopping(false)
+            {
+            }
+
+            void run() {
+                std::unique_lock<std::mutex> guard(lock);
+                for (;;) {
+                    wake.wait(guard, [this]() {
+                        return stopping || !items.empty();
+                    });
+                    if (items.empty()) {
+                        return;
+                    }
+                    auto item = std::move(items.front());
+                    items.pop_front();
+                    guard.unlock();
+                    item();
+                    guard.lock();
+                }
+            }
+
+            void post(std::function<void()> item) {
+                ++posted;
+                std::unique_lock<std::mutex> guard(lock);
+                items.push_back(std::move(item));
+                wake.notify_one();
+            }
+
+            std::mutex lock;
+            std::condition_variable wake;
+            std::deque<std::function<void()>> items;
+            std::atomic<long> posted;
+            bool stopping;
+        };
+    }
+
+    // runs everything posted to it on one thread, in order
+    class core_dispatcher_thread
+    {
+        typedef core_dispatcher_thread this_type;
+        core_dispatcher_thread(const this_type&);
+
+        std::shared_ptr<detail::dispatcher_state> state;
+        std::thread thread;
+
+    public:
+        core_dispatcher_thread()
+            : state(std::make_shared<detail::dispatcher_state>())
+        {
+            auto s = state;
+            thread = std::thread([s]() {
+                s->run();
+            });
+        }
+        ~core_dispatcher_thread()
+        {
+            {
+                std::unique_lock<std::mutex> guard(state->lock);
+                state->stopping = true;
+                state->wake.notify_one();
+            }
+            if (thread.get_id() == std::this_thread::get_id()) {
+                thread.detach();
+            }
+            else {
+                thread.join();
+            }
+        }
+
+        void post(std::function<void()> item) const {
+            state->post(std::move(item));
+        }
+
+        // the items posted so far - each one is a hop onto the thread
+        long posted() const {
+            return state->posted.load();
+        }
+
+        bool HasThreadAccess() const {
+            return std::this_thread::get_id() == thread.get_id();
+        }
+    };
+
+    struct core_dispatcher : public scheduler_interface
+    {
+    private:
+        typedef core_dispatcher this_type;
+        core_dispatcher(const this_type&);
+
+        struct core_dispatcher_worker : public worker_interface
+        {
+        private:
+            typedef core_dispatcher_worker this_type;
+            core_dispatcher_worker(const this_type&);
+
+            std::shared_ptr<dispatcher_queue> queue;
+
+        public:
+            core_dispatcher_worker(std::shared_ptr<core_dispatcher_thread> dispatcher, clock_type::duration budget, clock_type::duration frame, std::shared_ptr<dispatcher_budget_counters> counters)
+                : queue(std::make_shared<dispatcher_queue>(
+                    [dispatcher](std::function<void()> drain) {
+                        dispatcher->post(std::move(drain));
+                    },
+                    shared_timer_wheel(), budget, frame, std::move(counters), std::make_shared<detail::run_jitter>()))
+            {
+            }
+
+            std::shared_ptr<dispatcher_budget_counters> get_counters() const {
+                return queue->get_counters();
+            }
+
+            virtual clock_type::time_point now() const {
+                return clock_type::now();
+            }
+
+            virtual void schedule(const schedulable& scbl) const {
+                queue->schedule(clock_type::time_point(), scbl);
+            }
+
+            virtual void schedule(clock_type::time_point when, const schedulable& scbl) const {
+                if (when <= now()) {
+                    schedule(scbl);
+                    return;
+                }
+
+                auto queue = this->queue;
+                auto wheel = shared_timer_wheel();
+                auto timer = wheel->insert(when, [queue, when, scbl]() {
+                    queue->schedule(when, scbl);
+                });
+
+                scbl.add([wheel, timer]() {
+                    wheel->cancel(timer);
+                });
+            }
+        };
+
+        std::shared_ptr<core_dispatcher_worker> wi;
+
+    public:
+        explicit core_dispatcher(std::shared_ptr<core_dispatcher_thread> dispatcher)
+            : wi(std::make_shared<core_dispatcher_worker>(std::move(dispatcher), std::chrono::milliseconds(4), clock_type::duration::zero(), nullptr))
+        {
+        }
+        // spends at most budget of each frame on queued work
+        core_dispatcher(std::shared_ptr<core_dispatcher_thread> dispatcher, clock_type::duration budget, clock_type::duration frame, std::shared_ptr<dispatcher_budget_counters> counters)
+            : wi(std::make_shared<core_dispatcher_worker>(std::move(dispatcher), budget, frame, std::move(counters)))
+        {
+        }
+
+        virtual clock_type::time_point now() const {
+            return clock_type::now();
+        }
+
+        virtual worker create_worker(composite_subscription cs) const {
+            return worker(std::move(cs), wi);
+        }
+
+        std::shared_ptr<dispatcher_budget_counters> counters() const {
+            return wi->get_counters();
+        }
+    };
+
+    // the dispatcher of the stand-in for the current window
+    inline std::shared_ptr<core_dispatcher_thread> current_dispatcher() {
+        static auto instance = std::make_shared<core_dispatcher_thread>();
+        return instance;
+    }
+
+    inline scheduler make_core_dispatcher(std::shared_ptr<core_dispatcher_thread> dispatcher = current_dispatcher()) {
+        return make_scheduler<core_dispatcher>(std::move(dispatcher));
+    }
+
+    inline scheduler make_budgeted_core_dispatcher(
+        std::shared_ptr<core_dispatcher_thread> dispatcher,
+        scheduler_interface::clock_type::duration budget_per_frame,
+        std::shared_ptr<dispatcher_budget_counters> counters = nullptr,
+        scheduler_interface::clock_type::duration frame = std::chrono::microseconds(16667)) {
+        return make_scheduler<core_dispatcher>(std::move(dispatcher), budget_per_frame, frame, std::move(counters));
+    }
+
+    class core_dispatcher_coordination : public identity_one_worker
+    {
+        std::shared_ptr<core_dispatcher_thread> dispatcher;
+
+    public:
+        explicit core_dispatcher_coordination(std::shared_ptr<core_dispatcher_thread> dispatcher)
+            : identity_one_worker(make_core_dispatcher(dispatcher))
+            , dispatcher(dispatcher)
+        {
+        }
+
+        bool has_thread_access() const {
+            return dispatcher->HasThreadAccess();
+        }
+    };
+
+    inline core_dispatcher_coordination identity_core_dispatcher(std::shared_ptr<core_dispatcher_thread> dispatcher = current_dispatcher()) {
+        core_dispatcher_coordination r(std::move(dispatcher));
+        return r;
+    }
+}
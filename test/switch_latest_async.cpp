@@ -0,0 +1,115 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+#include "fake_async.h"
+
+#include <vector>
+
+// switch_latest_async mirrors only the newest operation - each new one
+// cancels the one it supersedes, and unsubscribing cancels the current one.
+
+typedef Rx::observable<int> inner_type;
+
+static void superseded_is_canceled() {
+    auto first = fake::make_async<int>();
+    auto second = fake::make_async<int>();
+    Rx::subject<inner_type> source;
+
+    std::vector<int> values;
+    bool completed = false;
+    auto lifetime = (source.get_observable() | Rx::switch_latest_async()).subscribe(
+        [&](int v) { values.push_back(v); },
+        [](std::exception_ptr) {},
+        [&]() { completed = true; });
+
+    source.get_subscriber().on_next(Rx::from_async(first.aop).as_dynamic());
+    CHECK(first.state->counters->cancels == 0);
+
+    source.get_subscriber().on_next(Rx::from_async(second.aop).as_dynamic());
+    CHECK(first.state->counters->cancels == 1);
+    CHECK(first.state->counters->closes == 1);
+    CHECK(second.state->counters->cancels == 0);
+
+    // the source ending waits for the current operation
+    source.get_subscriber().on_completed();
+    CHECK(!completed);
+
+    first.state->complete(1);
+    second.state->complete(2);
+    CHECK((values == std::vector<int>{2}));
+    CHECK(completed);
+    CHECK(second.state->counters->cancels == 0);
+    CHECK(second.state->counters->closes == 1);
+}
+
+static void unsubscribe_cancels_current() {
+    auto op = fake::make_async<int>();
+    Rx::subject<inner_type> source;
+
+    auto lifetime = (source.get_observable() | Rx::switch_latest_async()).subscribe([](int) {});
+    source.get_subscriber().on_next(Rx::from_async(op.aop).as_dynamic());
+
+    lifetime.unsubscribe();
+    CHECK(op.state->counters->cancels == 1);
+    CHECK(!source.has_observers());
+}
+
+static void inner_error_ends() {
+    auto first = fake::make_async<int>();
+    auto second = fake::make_async<int>();
+    Rx::subject<inner_type> source;
+
+    HRESULT error = S_OK;
+    auto lifetime = (source.get_observable() | Rx::switch_latest_async()).subscribe(
+        [](int) {},
+        [&](std::exception_ptr ep) {
+            try { std::rethrow_exception(ep); }
+            catch (const Modern::Exception& ex) { error = ex.Result; }
+        });
+
+    source.get_subscriber().on_next(Rx::from_async(first.aop).as_dynamic());
+    source.get_subscriber().on_next(Rx::from_async(second.aop).as_dynamic());
+
+    // the canceled operation's error is not the stream's
+    CHECK(error == S_OK);
+
+    second.state->fail(E_FAIL);
+    CHECK(error == E_FAIL);
+    CHECK(!source.has_observers());
+}
+
+static void switch_map() {
+    std::vector<fake::async_pair<int>> ops;
+    Rx::subject<int> query;
+
+    std::vector<int> values;
+    auto lifetime = (query.get_observable() | Rx::switch_map_async([&](int) {
+            ops.push_back(fake::make_async<int>());
+            auto aop = ops.back().aop;
+            return Rx::start_async([=]() { return aop; }).as_dynamic();
+        }))
+        .subscribe([&](int v) { values.push_back(v); });
+
+    for (int i = 0; i < 3; ++i) {
+        query.get_subscriber().on_next(i);
+    }
+    CHECK(ops.size() == 3);
+    CHECK(ops[0].state->counters->cancels == 1);
+    CHECK(ops[1].state->counters->cancels == 1);
+    CHECK(ops[2].state->counters->cancels == 0);
+
+    ops[2].state->complete(30);
+    CHECK((values == std::vector<int>{30}));
+
+    lifetime.unsubscribe();
+    CHECK(!query.has_observers());
+}
+
+int main() {
+    superseded_is_canceled();
+    unsubscribe_cancels_current();
+    inner_error_ends();
+    switch_map();
+    return check_result();
+}
@@ -0,0 +1,291 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// the wheel only moves when advance() is called, so every case here runs on
+// a virtual clock - an explicit origin and explicit advance(t) calls.
+
+typedef Rx::timer_wheel::clock_type clock_type;
+typedef std::chrono::milliseconds ms;
+typedef std::chrono::microseconds us;
+
+static const clock_type::time_point origin = clock_type::time_point(std::chrono::hours(1000));
+
+// follows the wheel from one wake-up to the next until t fires, noting the
+// level t sits at after each. returns the number of wake-ups.
+static int follow(Rx::timer_wheel& wheel, const Rx::timer_wheel::timer& t, clock_type::time_point deadline, bool& fired, std::vector<int>& levels) {
+    int wakes = 0;
+    levels.push_back(t->level);
+    while (!fired && wakes < 100) {
+        auto wake = wheel.next_wake();
+        CHECK(wake <= deadline);
+        if (wake > deadline) {
+            break;
+        }
+        wheel.advance(wake);
+        ++wakes;
+        if (!fired) {
+            CHECK(wake < deadline);
+            levels.push_back(t->level);
+        }
+    }
+    return wakes;
+}
+
+static void long_delay_cascades_down() {
+    // past the 214s that used to overflow a 32 bit count of 100ns ticks
+    Rx::timer_wheel wheel(ms(1), origin);
+    auto deadline = origin + std::chrono::seconds(300);
+    bool fired = false;
+    auto t = wheel.insert(deadline, [&]() {
+        fired = true;
+    });
+    CHECK(t->level == 2);
+
+    wheel.advance(deadline - ms(1));
+    CHECK(!fired);
+    std::vector<int> levels;
+    follow(wheel, t, deadline, fired, levels);
+    CHECK(fired);
+    CHECK(wheel.size() == 0);
+    CHECK(wheel.jitter().fired == 1);
+    CHECK(wheel.jitter().worst == clock_type::duration::zero());
+}
+
+static void beyond_max_delta_parks_and_recascades() {
+    // max_delta is 2^32 - 1 ticks. this deadline is past it and has a
+    // remainder at every level, so it parks in the outer wheel, is parked
+    // again when that slot comes round, and then moves down through each
+    // level in turn.
+    const std::int64_t ticks = (std::int64_t(1) << 32) + (std::int64_t(5) << 26) + (std::int64_t(3) << 20) + (std::int64_t(7) << 14) + (std::int64_t(9) << 8) + 77;
+    Rx::timer_wheel wheel(ms(1), origin);
+    auto deadline = origin + ms(ticks);
+    bool fired = false;
+    auto t = wheel.insert(deadline, [&]() {
+        fired = true;
+    });
+    CHECK(t->level == 4);
+
+    std::vector<int> levels;
+    auto wakes = follow(wheel, t, deadline, fired, levels);
+    CHECK(fired);
+    // parked at 4, parked again at 4, then 3, 2, 1, 0 and the deadline itself
+    CHECK(wakes == 6);
+    std::vector<int> expected = {4, 4, 3, 2, 1, 0};
+    CHECK(levels == expected);
+    CHECK(wheel.jitter().worst == clock_type::duration::zero());
+}
+
+static void short_deadlines_are_not_rounded_down() {
+    Rx::timer_wheel wheel(us(100), origin);
+    bool early = false;
+    bool late = false;
+    // not on a tick - rounds up to the 2.4ms tick, never down to 2.3ms
+    auto a = wheel.insert(origin + us(2350), [&]() {
+        early = true;
+    });
+    // sub-10ms, but not immediate
+    auto b = wheel.insert(origin + ms(3), [&]() {
+        late = true;
+    });
+    CHECK(wheel.next_wake() == origin + us(2400));
+
+    wheel.advance(origin);
+    CHECK(!early && !late);
+    wheel.advance(origin + us(2350));
+    CHECK(!early && !late);
+    wheel.advance(origin + us(2400));
+    CHECK(early && !late);
+    CHECK(wheel.next_wake() == origin + ms(3));
+    wheel.advance(origin + us(2900));
+    CHECK(!late);
+    wheel.advance(origin + ms(3));
+    CHECK(late);
+
+    auto jitter = wheel.jitter();
+    CHECK(jitter.fired == 2);
+    CHECK(jitter.worst == us(50));
+    (void)a;
+    (void)b;
+}
+
+static void cancel_after_cascade() {
+    Rx::timer_wheel wheel(ms(1), origin);
+    auto deadline = origin + std::chrono::seconds(20);
+    bool fired = false;
+    auto t = wheel.insert(deadline, [&]() {
+        fired = true;
+    });
+    CHECK(t->level == 2);
+
+    // the first wake-up only moves the timer down a level
+    wheel.advance(wheel.next_wake());
+    CHECK(!fired);
+    CHECK(t->level >= 0 && t->level < 2);
+
+    CHECK(wheel.cancel(t));
+    CHECK(!wheel.cancel(t));
+    CHECK(wheel.size() == 0);
+    CHECK(wheel.next_wake() == clock_type::time_point::max());
+    wheel.advance(deadline + std::chrono::seconds(1));
+    CHECK(!fired);
+    CHECK(wheel.jitter().fired == 0);
+}
+
+static void arms_for_the_next_wake() {
+    Rx::timer_wheel wheel(ms(1), origin);
+    std::vector<clock_type::time_point> armed;
+    wheel.set_arm([&](clock_type::time_point when) {
+        armed.push_back(when);
+    });
+    CHECK(armed.empty());
+
+    int fired = 0;
+    wheel.insert(origin + ms(5), [&]() {
+        ++fired;
+    });
+    CHECK(armed.size() == 1 && armed.back() == origin + ms(5));
+    // later than what is armed - no new arm
+    wheel.insert(origin + ms(50), [&]() {
+        ++fired;
+    });
+    CHECK(armed.size() == 1);
+    wheel.insert(origin + ms(2), [&]() {
+        ++fired;
+    });
+    CHECK(armed.size() == 2 && armed.back() == origin + ms(2));
+
+    // a level 1 timer wakes at its slot's cascade, before its deadline
+    wheel.insert(origin + ms(1000), [&]() {
+        ++fired;
+    });
+    CHECK(armed.size() == 2);
+
+    wheel.advance(origin + ms(2));
+    CHECK(fired == 1);
+    CHECK(armed.back() == origin + ms(5));
+    wheel.advance(origin + ms(50));
+    CHECK(fired == 3);
+    CHECK(armed.back() == origin + ms(768));
+    CHECK(wheel.next_wake() == origin + ms(768));
+    wheel.advance(origin + ms(768));
+    CHECK(fired == 3);
+    CHECK(armed.back() == origin + ms(1000));
+    wheel.advance(origin + ms(1000));
+    CHECK(fired == 4);
+    CHECK(wheel.next_wake() == clock_type::time_point::max());
+}
+
+static void jitter_histogram_matches_injected_lateness() {
+    Rx::timer_wheel wheel(ms(1), origin);
+    // one per bucket, two on bucket bounds - a bound belongs to its bucket
+    const us late[] = {us(0), us(100), us(300), us(700), us(1500), us(3000), us(7000), us(15000), us(30000)};
+    const int bucket[] = {0, 0, 1, 2, 3, 4, 5, 6, 7};
+    const int count = sizeof(late) / sizeof(late[0]);
+
+    clock_type::duration total(0);
+    for (int i = 0; i < count; ++i) {
+        // on a tick and far enough apart that each advance fires only its own
+        auto deadline = origin + ms(100) * (i + 1);
+        wheel.insert(deadline, []() {});
+        wheel.advance(deadline + late[i]);
+        total += late[i];
+    }
+
+    auto jitter = wheel.jitter();
+    CHECK(jitter.fired == count);
+    CHECK(jitter.total == total);
+    CHECK(jitter.worst == us(30000));
+    CHECK(jitter.mean() == total / count);
+    long long expected[Rx::timer_jitter_report::buckets] = {};
+    for (int i = 0; i < count; ++i) {
+        ++expected[bucket[i]];
+    }
+    for (int b = 0; b < Rx::timer_jitter_report::buckets; ++b) {
+        CHECK(jitter.histogram[b] == expected[b]);
+    }
+
+    wheel.reset_jitter();
+    CHECK(wheel.jitter().fired == 0);
+
+    // a run recorded before its deadline counts as on time
+    Rx::timer_jitter_report report;
+    report.record(-ms(1));
+    CHECK(report.fired == 1);
+    CHECK(report.worst == clock_type::duration::zero());
+    CHECK(report.histogram[0] == 1);
+}
+
+static void early_arm_and_spin() {
+    auto due = origin + ms(10);
+    CHECK(Rx::detail::early_arm(due, ms(1)) == origin + ms(9));
+    CHECK(Rx::detail::early_arm(due, clock_type::duration::zero()) == due);
+    CHECK(Rx::detail::early_arm(clock_type::time_point::max(), ms(1)) == clock_type::time_point::max());
+
+    // spins through the last granularity until the deadline
+    auto t = origin + ms(9);
+    int reads = 0;
+    auto now = Rx::detail::spin_until(due, ms(1), [&]() {
+        ++reads;
+        auto r = t;
+        t += us(250);
+        return r;
+    });
+    CHECK(now == due);
+    CHECK(reads == 5);
+
+    // woken further out than the granularity - never a long spin
+    t = origin;
+    reads = 0;
+    now = Rx::detail::spin_until(due, ms(1), [&]() {
+        ++reads;
+        return t;
+    });
+    CHECK(now == origin);
+    CHECK(reads == 1);
+
+    // already late
+    t = due + us(30);
+    now = Rx::detail::spin_until(due, ms(1), [&]() {
+        return t;
+    });
+    CHECK(now == due + us(30));
+}
+
+static void thread_driver_fires_on_time() {
+    // the one real-clock case - the portable driver on its own thread
+    auto wheel = Rx::make_thread_timer_wheel(ms(1));
+    std::atomic<bool> fired(false);
+    std::atomic<bool> early(false);
+    auto start = clock_type::now();
+    auto deadline = start + ms(20);
+    // armed before the nearer one below, so the driver is re-armed earlier
+    wheel->insert(start + ms(500), []() {});
+    wheel->insert(deadline, [&]() {
+        early = clock_type::now() < deadline;
+        fired = true;
+    });
+    while (!fired && clock_type::now() < start + std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(ms(1));
+    }
+    CHECK(fired);
+    CHECK(!early);
+}
+
+int main() {
+    long_delay_cascades_down();
+    beyond_max_delta_parks_and_recascades();
+    short_deadlines_are_not_rounded_down();
+    cancel_after_cascade();
+    arms_for_the_next_wake();
+    jitter_histogram_matches_injected_lateness();
+    early_arm_and_spin();
+    thread_driver_fires_on_time();
+    return check_result();
+}
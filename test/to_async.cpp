@@ -0,0 +1,151 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+
+#include <vector>
+
+using namespace Modern;
+
+// to_async exposes a pipeline as an IAsyncOperationWithProgress - progress
+// goes to the Progress handler, the last result is the result and Cancel
+// unsubscribes both observables.
+
+typedef Windows::Foundation::IAsyncOperationWithProgress<int, int> operation_type;
+
+static HRESULT results_error(const operation_type& aop) {
+    try { aop.GetResults(); }
+    catch (const Modern::Exception& ex) { return ex.Result; }
+    return S_OK;
+}
+
+static void progress_and_result() {
+    Rx::subject<int> result, progress;
+    auto aop = Rx::to_async(result.get_observable(), progress.get_observable());
+
+    std::vector<int> reported;
+    int invoked = 0;
+    AsyncStatus completed_with = AsyncStatus::Started;
+    aop.Progress([&](const operation_type&, int p) { reported.push_back(p); });
+    aop.Completed([&](const operation_type& sender, AsyncStatus s) {
+        ++invoked;
+        completed_with = s;
+        CHECK(sender == aop);
+    });
+
+    progress.get_subscriber().on_next(10);
+    result.get_subscriber().on_next(1);
+    progress.get_subscriber().on_next(50);
+    // progress ending does not end the operation
+    progress.get_subscriber().on_completed();
+    CHECK(aop.Status() == AsyncStatus::Started);
+    CHECK(results_error(aop) == E_ILLEGAL_METHOD_CALL);
+
+    result.get_subscriber().on_next(2);
+    result.get_subscriber().on_completed();
+
+    CHECK((reported == std::vector<int>{10, 50}));
+    CHECK(invoked == 1);
+    CHECK(completed_with == AsyncStatus::Completed);
+    CHECK(aop.Status() == AsyncStatus::Completed);
+    CHECK(aop.ErrorCode() == S_OK);
+    CHECK(aop.GetResults() == 2);
+
+    aop.Close();
+    HRESULT closed = S_OK;
+    try { aop.Status(); }
+    catch (const Modern::Exception& ex) { closed = ex.Result; }
+    CHECK(closed == E_ILLEGAL_METHOD_CALL);
+}
+
+static void cancel_unsubscribes() {
+    Rx::subject<int> result, progress;
+    auto aop = Rx::to_async(result.get_observable(), progress.get_observable());
+    CHECK(result.has_observers());
+    CHECK(progress.has_observers());
+
+    AsyncStatus completed_with = AsyncStatus::Started;
+    aop.Completed([&](const operation_type&, AsyncStatus s) { completed_with = s; });
+
+    aop.Cancel();
+    CHECK(!result.has_observers());
+    CHECK(!progress.has_observers());
+    CHECK(completed_with == AsyncStatus::Canceled);
+    CHECK(aop.Status() == AsyncStatus::Canceled);
+    CHECK(results_error(aop) == HRESULT_FROM_WIN32(ERROR_CANCELLED));
+
+    // a result after the cancel does not change the outcome
+    result.get_subscriber().on_next(1);
+    result.get_subscriber().on_completed();
+    CHECK(aop.Status() == AsyncStatus::Canceled);
+}
+
+static void error_and_empty() {
+    auto failed = Rx::to_async<int, int>(Rx::observable<>::error<int>(std::make_exception_ptr(Modern::Exception(E_PENDING))));
+    CHECK(failed.Status() == AsyncStatus::Error);
+    CHECK(failed.ErrorCode() == E_PENDING);
+    CHECK(results_error(failed) == E_PENDING);
+
+    auto empty = Rx::to_async<int, int>(Rx::observable<>::empty<int>());
+    CHECK(empty.Status() == AsyncStatus::Error);
+    CHECK(empty.ErrorCode() == HRESULT_FROM_WIN32(ERROR_NO_DATA));
+}
+
+static void late_and_repeated_handlers() {
+    auto aop = Rx::to_async<int, int>(Rx::observable<>::just(5));
+    CHECK(aop.Status() == AsyncStatus::Completed);
+
+    // a handler assigned after the end is called immediately
+    int invoked = 0;
+    aop.Completed([&](const operation_type&, AsyncStatus s) {
+        ++invoked;
+        CHECK(s == AsyncStatus::Completed);
+    });
+    CHECK(invoked == 1);
+
+    HRESULT again = S_OK;
+    try { aop.Completed([&](const operation_type&, AsyncStatus) { ++invoked; }); }
+    catch (const Modern::Exception& ex) { again = ex.Result; }
+    CHECK(again == E_ILLEGAL_DELEGATE_ASSIGNMENT);
+    CHECK(invoked == 1);
+}
+
+static void close_before_end() {
+    Rx::subject<int> result;
+    auto aop = Rx::to_async<int, int>(result.get_observable());
+
+    HRESULT early = S_OK;
+    try { aop.Close(); }
+    catch (const Modern::Exception& ex) { early = ex.Result; }
+    CHECK(early == E_ILLEGAL_STATE_CHANGE);
+    CHECK(aop.Status() == AsyncStatus::Started);
+    aop.Cancel();
+}
+
+static void round_trip() {
+    Rx::subject<int> result;
+    auto aop = Rx::to_async<int, int>(result.get_observable());
+
+    // unsubscribing from from_async cancels the operation and that
+    // unsubscribes the pipeline behind it
+    auto lifetime = Rx::from_async(aop).subscribe([](int) {});
+    CHECK(result.has_observers());
+    lifetime.unsubscribe();
+    CHECK(!result.has_observers());
+
+    // and from_async closed it once the cancel completed it
+    HRESULT closed = S_OK;
+    try { aop.Status(); }
+    catch (const Modern::Exception& ex) { closed = ex.Result; }
+    CHECK(closed == E_ILLEGAL_METHOD_CALL);
+}
+
+int main() {
+    progress_and_result();
+    cancel_unsubscribes();
+    error_and_empty();
+    late_and_repeated_handlers();
+    close_before_end();
+    round_trip();
+    return check_result();
+}
@@ -0,0 +1,190 @@
+#include <modern.h>
+#include <rx.modern.h>
+
+#include "check.h"
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+// stress for the work-stealing pool and the structures under it. each item
+// must be taken exactly once however the owner and the thieves interleave.
+
+static void deque_owner_and_thieves() {
+    const int count = 200000;
+    // starts small so that the ring grows while thieves are reading it
+    Rx::detail::chase_lev_deque<int> deque(4);
+    std::vector<int> items(count);
+    std::vector<std::atomic<int>> taken(count);
+    for (int i = 0; i < count; ++i) {
+        items[i] = i;
+        taken[i] = 0;
+    }
+
+    std::atomic<int> total(0);
+    std::atomic<bool> done(false);
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+        thieves.emplace_back([&]() {
+            while (!done) {
+                if (auto item = deque.steal()) {
+                    ++taken[*item];
+                    ++total;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < count; ++i) {
+        deque.push(&items[i]);
+        if (i % 3 == 0) {
+            if (auto item = deque.pop()) {
+                ++taken[*item];
+                ++total;
+            }
+        }
+    }
+    while (auto item = deque.pop()) {
+        ++taken[*item];
+        ++total;
+    }
+    while (total < count) {
+        std::this_thread::yield();
+    }
+    done = true;
+    for (auto& t : thieves) {
+        t.join();
+    }
+
+    CHECK(total == count);
+    CHECK(deque.empty());
+    int once = 0;
+    for (auto& t : taken) {
+        once += t == 1 ? 1 : 0;
+    }
+    CHECK(once == count);
+}
+
+static void mpsc_keeps_producer_order() {
+    const int producers = 4;
+    const int count = 50000;
+    Rx::detail::mpsc_queue<int> queue;
+
+    std::atomic<int> finished(0);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < count; ++i) {
+                queue.push(p * count + i);
+            }
+            ++finished;
+        });
+    }
+
+    std::vector<int> last(producers, -1);
+    std::deque<int> batch;
+    long received = 0;
+    bool ordered = true;
+    while (finished < producers || !queue.empty()) {
+        batch.clear();
+        queue.take_all(batch);
+        for (int v : batch) {
+            auto p = v / count;
+            auto i = v % count;
+            ordered = ordered && i == last[p] + 1;
+            last[p] = i;
+            ++received;
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    CHECK(ordered);
+    CHECK(received == long(producers) * count);
+}
+
+static void pool_runs_everything_once() {
+    const int count = 100000;
+    std::atomic<int> ran(0);
+    std::atomic<int> children(0);
+    {
+        auto pool = Rx::make_work_stealing_pool(4);
+        auto w = pool.create_worker();
+
+        // from outside the pool - the shared queue - and from inside - the
+        // owner's deque, where the other threads steal them
+        for (int i = 0; i < count; ++i) {
+            w.schedule(Rx::schedulers::make_schedulable(w, [&, w](const Rx::schedulable&) {
+                if (++ran % 4 == 0) {
+                    w.schedule(Rx::schedulers::make_schedulable(w, [&](const Rx::schedulable&) {
+                        ++children;
+                    }));
+                }
+            }));
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while ((ran < count || children < count / 4) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    CHECK(ran == count);
+    CHECK(children == count / 4);
+}
+
+static void pool_delays_and_cancels() {
+    typedef std::chrono::steady_clock clock_type;
+    auto pool = Rx::make_work_stealing_pool(2);
+    auto w = pool.create_worker();
+
+    std::atomic<int> early(0);
+    std::atomic<int> ran(0);
+    std::atomic<int> canceled_ran(0);
+    for (int i = 0; i < 10; ++i) {
+        auto due = clock_type::now() + std::chrono::milliseconds(20 + i);
+        w.schedule(due, Rx::schedulers::make_schedulable(w, Rx::composite_subscription(), [&, due](const Rx::schedulable&) {
+            early += clock_type::now() < due ? 1 : 0;
+            ++ran;
+        }));
+    }
+    Rx::composite_subscription canceled;
+    w.schedule(clock_type::now() + std::chrono::milliseconds(20), Rx::schedulers::make_schedulable(w, canceled, [&](const Rx::schedulable&) {
+        ++canceled_ran;
+    }));
+    canceled.unsubscribe();
+
+    auto deadline = clock_type::now() + std::chrono::seconds(10);
+    while (ran < 10 && clock_type::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(ran == 10);
+    CHECK(early == 0);
+    CHECK(canceled_ran == 0);
+}
+
+static void pool_stops_with_work_queued() {
+    std::atomic<int> ran(0);
+    {
+        auto pool = Rx::make_work_stealing_pool(2);
+        auto w = pool.create_worker();
+        for (int i = 0; i < 10000; ++i) {
+            w.schedule(Rx::schedulers::make_schedulable(w, [&](const Rx::schedulable&) {
+                ++ran;
+            }));
+        }
+    }
+    // whatever did not run was freed with the pool
+    CHECK(ran <= 10000);
+}
+
+int main() {
+    deque_owner_and_thieves();
+    mpsc_keeps_producer_order();
+    pool_runs_everything_once();
+    pool_delays_and_cancels();
+    pool_stops_with_work_queued();
+    return check_result();
+}